@@ -1,5 +1,7 @@
 #include "aStar.h"
 
+#define ANYTIME_WEIGHT_STEP 0.5
+
 cell * GetCell(int X, int Y, astar_grid *Grid) 
 {
     if ((X >= 0) && (X < Grid->NumberRows)
@@ -11,6 +13,178 @@ cell * GetCell(int X, int Y, astar_grid *Grid)
     return NULL;
 } 
 
+search_node * GetNode(point Location, astar_search *Search) 
+{
+    return &Search->Nodes[Location.Row * Search->NumberCols + Location.Col];
+}
+
+/*
+    Search scratch (f, g, h, parent, heap slot, closed flag) is only valid
+    when the node's Stamp matches Search->SearchId; anything else is left
+    over from an older search and gets reset on first touch.
+*/
+static search_node * RefreshNode(search_node *Node, unsigned int SearchId) 
+{
+    if (Node->Stamp != SearchId) {
+        Node->Stamp = SearchId;
+        Node->f = -1;
+        Node->g = 0.0;
+        Node->h = 0.0;
+        Node->HeapIndex = -1;
+        Node->Closed = false;
+    }
+
+    return Node;
+}
+
+search_node * TouchNode(point Location, astar_search *Search) 
+{
+    return RefreshNode(GetNode(Location, Search), Search->SearchId);
+}
+
+static search_node * TouchReverseNode(point Location, astar_search *Search) 
+{
+    return RefreshNode(&Search->ReverseNodes[Location.Row * Search->NumberCols + Location.Col], Search->SearchId);
+}
+
+static bool WasReachedBackward(point Location, astar_search *Search) 
+{
+    search_node *Node = &Search->ReverseNodes[Location.Row * Search->NumberCols + Location.Col];
+    return Node->Stamp == Search->SearchId && Node->f >= 0;
+}
+
+static void UseReverseNodes(astar_search *Search) 
+{
+    if (Search->ReverseNodes == NULL) {
+        Search->ReverseNodes = (search_node*) calloc(Search->NumberRows * Search->NumberCols, sizeof(search_node));
+        Search->ReverseOpenList.Scratch = Search->ReverseNodes;
+    }
+}
+
+/*
+    Grows the graph scratch to Length nodes. The new nodes carry Stamp 0,
+    which no search uses, so they start out untouched like the rest.
+*/
+static search_node * UseGraphNodes(astar_search *Search, int Length) 
+{
+    if (Length > Search->GraphNodesCapacity) {
+        Search->GraphNodes = (search_node*) realloc(Search->GraphNodes, Length * sizeof(search_node));
+        memset(&Search->GraphNodes[Search->GraphNodesCapacity], 0, (Length - Search->GraphNodesCapacity) * sizeof(search_node));
+        Search->GraphNodesCapacity = Length;
+        Search->GraphOpenList.Scratch = Search->GraphNodes;
+    }
+
+    return Search->GraphNodes;
+}
+
+/* Grows the int scratch of the abstract searches to Length. */
+static int * UseGraphDistances(astar_search *Search, int Length) 
+{
+    if (Length > Search->GraphDistancesCapacity) {
+        Search->GraphDistances = (int*) realloc(Search->GraphDistances, Length * sizeof(int));
+        Search->GraphDistancesCapacity = Length;
+    }
+
+    return Search->GraphDistances;
+}
+
+static search_node * TouchGraphNode(int u, astar_search *Search) 
+{
+    return RefreshNode(&Search->GraphNodes[u], Search->SearchId);
+}
+
+/*
+    Neither g nor h can pass the number of cells, so f always has a 
+    bucket of its own.
+*/
+static void UseBucketNodes(astar_search *Search) 
+{
+    if (Search->BucketNodes == NULL) {
+        int CellsLength = Search->NumberRows * Search->NumberCols;
+        Search->BucketNodes = (bucket_node*) calloc(CellsLength, sizeof(bucket_node));
+        InitBucketQueue(&Search->Buckets, 2 * CellsLength + 1, Search->BucketNodes);
+    }
+}
+
+/* Two lists of up to one entry per cell, laid out back to back. */
+static point * UseCellLists(astar_search *Search) 
+{
+    if (Search->CellLists == NULL)
+        Search->CellLists = (point*) malloc(2 * Search->NumberRows * Search->NumberCols * sizeof(point));
+
+    return Search->CellLists;
+}
+
+static void BeginSearch(astar_search *Search) 
+{
+    Search->SearchId++;
+    if (Search->SearchId == 0) {
+        for (int i = 0; i < Search->NumberRows * Search->NumberCols; i++) {
+            Search->Nodes[i].Stamp = 0;
+            if (Search->ReverseNodes)
+                Search->ReverseNodes[i].Stamp = 0;
+            if (Search->BucketNodes)
+                Search->BucketNodes[i].Stamp = 0;
+        }
+        for (int i = 0; i < Search->GraphNodesCapacity; i++) {
+            Search->GraphNodes[i].Stamp = 0;
+        }
+        Search->SearchId = 1;
+    }
+
+    Search->OpenList.Size = 0;
+    Search->ReverseOpenList.Size = 0;
+    Search->GraphOpenList.Size = 0;
+    Search->Expanded = 0;
+    Search->Status = SEARCH_IDLE;
+}
+
+astar_search * CreateAStarSearch(astar_grid *Grid) 
+{
+    astar_search *Search = (astar_search*) malloc(sizeof(astar_search));
+    Search->NumberRows = Grid->NumberRows;
+    Search->NumberCols = Grid->NumberCols;
+    Search->Nodes = (search_node*) calloc(Grid->NumberRows * Grid->NumberCols, sizeof(search_node));
+    Search->SearchId = 0;
+    Search->Mode = SEARCH_MODE_ASTAR;
+    Search->Heuristic = HEURISTIC_MANHATTAN;
+    Search->Expanded = 0;
+    Search->Weight = 1.0;
+    Search->AnytimeBudget = 0;
+    Search->Bound = 1.0;
+    Search->Status = SEARCH_IDLE;
+    InitHeap(&Search->OpenList, 64, Search->Nodes, Search->NumberCols);
+
+    // only bidirectional searches need the second set of scratch
+    Search->ReverseNodes = NULL;
+    InitHeap(&Search->ReverseOpenList, 0, NULL, Search->NumberCols);
+    Search->BucketNodes = NULL;
+    Search->Buckets = (bucket_queue) {NULL, 0, 0, -1, 0, NULL};
+    Search->CellLists = NULL;
+    Search->GraphNodes = NULL;
+    Search->GraphNodesCapacity = 0;
+    Search->GraphDistances = NULL;
+    Search->GraphDistancesCapacity = 0;
+    InitHeap(&Search->GraphOpenList, 0, NULL, 1);
+
+    return Search;
+}
+
+void DestroyAStarSearch(astar_search *Search) 
+{
+    DestroyHeap(&Search->OpenList);
+    DestroyHeap(&Search->ReverseOpenList);
+    DestroyHeap(&Search->GraphOpenList);
+    DestroyBucketQueue(&Search->Buckets);
+    free(Search->Nodes);
+    free(Search->ReverseNodes);
+    free(Search->BucketNodes);
+    free(Search->CellLists);
+    free(Search->GraphNodes);
+    free(Search->GraphDistances);
+    free(Search);
+}
+
 bool EqualPoints(point PointA, point PointB) 
 {
     if (PointA.Row == PointB.Row && PointA.Col == PointB.Col) 
@@ -32,286 +206,1391 @@ bool IsNeighbour(point Location, point Neighbour, astar_grid *Grid)
     return false;
 }
 
-double CalculateHeuristic(point Source, point Dest, cell Node) 
+double CalculateHeuristic(point Source, point Dest, search_node Node) 
 {
     double hNew = (abs(Source.Row - Dest.Row) + abs(Source.Col - Dest.Col));
     double gNew = Node.g + 1.0;
     return (gNew + hNew);
 }
 
-void CloneQueue(Tqueue *Queue, Tqueue *Clone) 
+/*
+    Lower bound on the road distance the landmark tables give through
+    the triangle inequality; 0 while they are missing or out of date.
+*/
+double LandmarkDistance(point From, point To, astar_grid *Grid) 
 {
-    node *temp = Queue->head;
-    while(temp != NULL) {
-        PushQueue(Clone, temp->Data);
-        temp = temp->next;
+    landmarks *Landmarks = Grid->Landmarks;
+    if (Landmarks == NULL || Landmarks->Version != Grid->Version)
+        return 0.0;
+
+    double Estimate = 0.0;
+    int FromIndex = From.Row * Grid->NumberCols + From.Col;
+    int ToIndex = To.Row * Grid->NumberCols + To.Col;
+    for (int k = 0; k < Landmarks->Length; k++) {
+        int *Distances = &Landmarks->Distances[k * Landmarks->CellsLength];
+        if (Distances[FromIndex] < 0 || Distances[ToIndex] < 0)
+            continue;
+
+        double Bound = abs(Distances[FromIndex] - Distances[ToIndex]);
+        if (Bound > Estimate)
+            Estimate = Bound;
     }
+
+    return Estimate;
 }
 
-void InitQueue(Tqueue *Queue, size_t memSize, compare_function Function)
+/*
+    Manhattan distance, tightened with the landmark bound when the search
+    asks for it and the tables are up to date. Both are consistent, so
+    their maximum is too.
+*/
+double EstimateDistance(point From, point To, astar_grid *Grid, astar_search *Search) 
 {
-   Queue->CompareFunction = Function;
-   Queue->memSize = memSize;
-   Queue->head  = NULL;
+    double Estimate = abs(From.Row - To.Row) + abs(From.Col - To.Col);
+    if (Search->Heuristic != HEURISTIC_LANDMARKS)
+        return Estimate;
+
+    return fmax(Estimate, LandmarkDistance(From, To, Grid));
 }
 
-void PrintQueue(Tqueue *Queue) 
+void SetCellMovementCost(astar_grid *Grid, point Location, int MovementCost) 
 {
-    node *Temp = Queue->head;
-    while (Temp != NULL) {
-        DEBUG_PRINT("(%d %d %.0f)->", ((cell*)((Temp)->Data))->Location.Row, ((cell*)((Temp)->Data))->Location.Col, ((cell*)((Temp)->Data))->f);
-        Temp = Temp->next;
+    if (Grid->Map[Location.Row][Location.Col].MovementCost == MovementCost)
+        return;
+
+    Grid->Map[Location.Row][Location.Col].MovementCost = MovementCost;
+    Grid->Version++;
+
+    if (Grid->Passability != NULL) {
+        SetPassable(Grid->Passability, Location, Grid->IsOpenCellFunction(Location, Grid));
+        Grid->Passability->Version = Grid->Version;
     }
 }
 
-int ComparePriority(const void *x1, const void *x2) 
+passability * CreatePassability(astar_grid *Grid) 
 {
-    if (((cell*)(((node*)(x1))->Data))->f > ((cell*)(x2))->f)
-        return 1;
-    return 0;
+    passability *Passability = (passability*) malloc(sizeof(passability));
+    Passability->NumberRows = Grid->NumberRows;
+    Passability->NumberCols = Grid->NumberCols;
+    Passability->WordsPerRow = (Grid->NumberCols + 63) / 64;
+    Passability->Bits = (uint64_t*) malloc(Passability->NumberRows * Passability->WordsPerRow * sizeof(uint64_t));
+    BuildPassability(Passability, Grid);
+
+    return Passability;
 }
 
-void PushQueue(Tqueue *Queue, void* data) 
+void BuildPassability(passability *Passability, astar_grid *Grid) 
 {
-    node *newNode = (node*) malloc(sizeof(node));
-    node *temp = Queue->head;
+    memset(Passability->Bits, 0, Passability->NumberRows * Passability->WordsPerRow * sizeof(uint64_t));
+    for (int i = 0; i < Grid->NumberRows; i++) {
+        for (int j = 0; j < Grid->NumberCols; j++) {
+            if (Grid->IsOpenCellFunction((point) {i, j}, Grid))
+                SetPassable(Passability, (point) {i, j}, true);
+        }
+    }
 
-    if(newNode == NULL) {
-        return -1;
+    Passability->Version = Grid->Version;
+}
+
+void SetPassable(passability *Passability, point Location, bool Passable) 
+{
+    uint64_t *Word = &Passability->Bits[Location.Row * Passability->WordsPerRow + Location.Col / 64];
+    uint64_t Bit = (uint64_t) 1 << (Location.Col % 64);
+    if (Passable)
+        *Word |= Bit;
+    else
+        *Word &= ~Bit;
+}
+
+void DestroyPassability(passability *Passability) 
+{
+    free(Passability->Bits);
+    free(Passability);
+}
+
+/*
+    Breadth first wavefront over the passability bitmap: every round
+    spreads the frontier of a whole 64 cell word sideways with shifts
+    and up and down with the words of the next rows, so the cost goes
+    with the number of words instead of one callback per cell. All
+    Sources start at distance 0.
+*/
+void BitParallelDistances(astar_grid *Grid, point *Sources, int SourcesLength, int *Distances) 
+{
+    passability *Passability = Grid->Passability;
+    int Rows = Passability->NumberRows;
+    int Words = Passability->WordsPerRow;
+    int Length = Rows * Words;
+    uint64_t *Visited = (uint64_t*) calloc(3 * Length, sizeof(uint64_t));
+    uint64_t *Frontier = Visited + Length;
+    uint64_t *Next = Frontier + Length;
+
+    for (int i = 0; i < Grid->NumberRows * Grid->NumberCols; i++) {
+        Distances[i] = -1;
     }
 
-    newNode->Data = malloc(Queue->memSize);
+    // rows holding frontier bits; only they and their neighbours can grow.
+    // Rows left out keep bits of older rounds, whose neighbours are all
+    // visited already, so they never reach anything again.
+    int Top = Rows, Bottom = -1;
+    for (int i = 0; i < SourcesLength; i++) {
+        point Source = Sources[i];
+        if (!IsWalkable(Source, Grid))
+            continue;
 
-    if(newNode->Data == NULL) {
-        free(newNode);
-        return -1;
+        int w = Source.Row * Words + Source.Col / 64;
+        Frontier[w] |= (uint64_t) 1 << (Source.Col % 64);
+        Visited[w] |= (uint64_t) 1 << (Source.Col % 64);
+        Distances[Source.Row * Grid->NumberCols + Source.Col] = 0;
+        Top = Source.Row < Top ? Source.Row : Top;
+        Bottom = Source.Row > Bottom ? Source.Row : Bottom;
     }
 
-    newNode->next = NULL;
+    for (int Distance = 1; Top <= Bottom; Distance++) {
+        int From = Top > 0 ? Top - 1 : 0;
+        int To = Bottom + 1 < Rows ? Bottom + 1 : Rows - 1;
+        Top = Rows;
+        Bottom = -1;
 
-    memcpy(newNode->Data, data, Queue->memSize);
+        for (int r = From; r <= To; r++) {
+            for (int w = 0; w < Words; w++) {
+                int i = r * Words + w;
+                uint64_t Spread = Frontier[i] | (Frontier[i] << 1) | (Frontier[i] >> 1);
+                if (w > 0)
+                    Spread |= Frontier[i - 1] >> 63;
+                if (w + 1 < Words)
+                    Spread |= Frontier[i + 1] << 63;
+                if (r > 0)
+                    Spread |= Frontier[i - Words];
+                if (r + 1 < Rows)
+                    Spread |= Frontier[i + Words];
 
-    if(IsQueueEmpty(Queue)) {
-        Queue->head  = newNode;
-    } else {
-        if (Queue->CompareFunction == NULL) {
-            while (temp->next != NULL) {
-                temp = temp->next;
-            }
-            
-            newNode->next = temp->next;
-            temp->next = newNode;
-            return;
-        }
+                uint64_t Reached = Spread & Passability->Bits[i] & ~Visited[i];
+                Next[i] = Reached;
+                if (Reached == 0)
+                    continue;
 
-        if (Queue->CompareFunction((void*)(temp), data) == 1) {
-            newNode->next = Queue->head;
-            Queue->head = newNode;
-        } else {
-            while (temp->next != NULL && Queue->CompareFunction((void*)(temp), data) == 0) {
-                temp = temp->next;
+                Top = r < Top ? r : Top;
+                Bottom = r;
+                Visited[i] |= Reached;
+                while (Reached != 0) {
+                    int Col = w * 64 + __builtin_ctzll(Reached);
+                    Distances[r * Grid->NumberCols + Col] = Distance;
+                    Reached &= Reached - 1;
+                }
             }
-
-            newNode->next = temp->next;
-            temp->next = newNode;
         }
+
+        uint64_t *Swap = Frontier;
+        Frontier = Next;
+        Next = Swap;
     }
+
+    free(Visited);
 }
 
-void PeekQueue(Tqueue *Queue, void *data) 
+/* 
+    Fills Distances (one int per cell, -1 when unreachable) with the
+    number of steps from Source. Queue needs room for one int per cell
+    and is not touched when the passability bitmap can be used instead.
+*/
+void BreadthFirstDistances(astar_grid *Grid, point Source, int *Distances, int *Queue) 
 {
-   if(!IsQueueEmpty(Queue)) {
-       node *temp = Queue->head;
-       memcpy(data, temp->Data, Queue->memSize);
+    if (Grid->Passability != NULL && Grid->Passability->Version == Grid->Version) {
+        BitParallelDistances(Grid, &Source, 1, Distances);
+        return;
     }
-}
 
-void PopQueue(Tqueue *Queue) 
-{ 
-    if(!IsQueueEmpty(Queue)) {
-        node *temp = Queue->head;
-        // memcpy(data, temp->data, Queue->memSize);
+    const int Directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    int CellsLength = Grid->NumberRows * Grid->NumberCols;
 
-        if(Queue->head->next != NULL) {
-            Queue->head = Queue->head->next;
-        } else {
-            Queue->head = NULL;
+    for (int i = 0; i < CellsLength; i++) {
+        Distances[i] = -1;
+    }
+
+    if (!IsWalkable(Source, Grid))
+        return;
+
+    int Head = 0, Tail = 0;
+    Distances[Source.Row * Grid->NumberCols + Source.Col] = 0;
+    Queue[Tail++] = Source.Row * Grid->NumberCols + Source.Col;
+
+    while (Head < Tail) {
+        int Index = Queue[Head++];
+        point Current = {Index / Grid->NumberCols, Index % Grid->NumberCols};
+
+        for (int k = 0; k < 4; k++) {
+            point Neighbour = {Current.Row + Directions[k][0], Current.Col + Directions[k][1]};
+            int NeighbourIndex = Neighbour.Row * Grid->NumberCols + Neighbour.Col;
+            if (!IsWalkable(Neighbour, Grid) || Distances[NeighbourIndex] >= 0)
+                continue;
+
+            Distances[NeighbourIndex] = Distances[Index] + 1;
+            Queue[Tail++] = NeighbourIndex;
         }
+    }
+}
 
-        free(temp->Data);
-        free(temp);
+distance_field * CreateDistanceField(astar_grid *Grid) 
+{
+    distance_field *Field = (distance_field*) malloc(sizeof(distance_field));
+    Field->CellsLength = Grid->NumberRows * Grid->NumberCols;
+    Field->SourcesLength = -1;
+    Field->Version = Grid->Version;
+    Field->Distances = (int*) malloc(Field->CellsLength * sizeof(int));
+    for (int i = 0; i < Field->CellsLength; i++) {
+        Field->Distances[i] = -1;
     }
+
+    return Field;
 }
 
-int IsQueueEmpty(Tqueue *Queue) 
+void BuildDistanceField(distance_field *Field, astar_grid *Grid, point *Sources, int SourcesLength) 
 {
-    if (Queue->head == NULL) 
-        return 1;
-    return 0;
+    BitParallelDistances(Grid, Sources, SourcesLength, Field->Distances);
+    Field->SourcesLength = SourcesLength;
+    Field->Version = Grid->Version;
 }
 
-void DestroyQueue(Tqueue *Queue) 
+int FieldDistance(distance_field *Field, astar_grid *Grid, point Location) 
 {
-    node *temp;
+    if (Location.Row < 0 || Location.Row >= Grid->NumberRows || Location.Col < 0 || Location.Col >= Grid->NumberCols)
+        return -1;
+    return Field->Distances[Location.Row * Grid->NumberCols + Location.Col];
+}
 
-     while(!IsQueueEmpty(Queue)) {
-        temp = Queue->head;
-        Queue->head = temp->next;
-        free(temp->Data);
-        free(temp);
+/*
+    The neighbour one step closer to the nearest source, or From itself
+    when it is a source or none can be reached.
+*/
+point NextFieldStep(distance_field *Field, astar_grid *Grid, point From) 
+{
+    const int Directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    int Distance = FieldDistance(Field, Grid, From);
+    if (Distance <= 0)
+        return From;
+
+    for (int k = 0; k < 4; k++) {
+        point Neighbour = {From.Row + Directions[k][0], From.Col + Directions[k][1]};
+        if (FieldDistance(Field, Grid, Neighbour) == Distance - 1)
+            return Neighbour;
     }
 
-    Queue->head = NULL;
+    return From;
 }
 
-Tstack * NewStackNode(cell Node) 
+void DestroyDistanceField(distance_field *Field) 
 {
-    Tstack *NewNode = malloc(sizeof(Tstack));
-    NewNode->Data.f = Node.f;
-    NewNode->Data.g = Node.g;
-    NewNode->Data.h = Node.h;
-    NewNode->Data.Location.Row = Node.Location.Row;
-    NewNode->Data.Location.Col = Node.Location.Col;
-    NewNode->next = NULL;
+    if (Field == NULL)
+        return;
 
-    return NewNode;
+    free(Field->Distances);
+    free(Field);
 }
 
-
-int IsStackEmpty(Tstack *Stack) 
+components * CreateComponents(astar_grid *Grid) 
 {
-    if (Stack == NULL) 
-        return 1;
-    return 0;
+    components *Components = (components*) malloc(sizeof(components));
+    Components->CellsLength = Grid->NumberRows * Grid->NumberCols;
+    Components->Labels = (int*) malloc(Components->CellsLength * sizeof(int));
+    BuildComponents(Components, Grid);
+
+    return Components;
 }
 
-void PushStack(Tstack **Stack, cell Node)
+/*
+    Floods every still unlabeled road cell; each flood is one component.
+*/
+void BuildComponents(components *Components, astar_grid *Grid) 
 {
-    Tstack *NewNode = NewStackNode(Node);
+    const int Directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    int *Queue = (int*) malloc(Components->CellsLength * sizeof(int));
 
-    if (IsStackEmpty(*Stack)) {
-        (*Stack) = NewNode;
-    } else {
-        NewNode->next = (*Stack);
-        (*Stack) = NewNode;
+    for (int i = 0; i < Components->CellsLength; i++) {
+        Components->Labels[i] = -1;
     }
+
+    Components->Length = 0;
+    for (int i = 0; i < Components->CellsLength; i++) {
+        point Source = {i / Grid->NumberCols, i % Grid->NumberCols};
+        if (Components->Labels[i] >= 0 || !IsWalkable(Source, Grid))
+            continue;
+
+        int Label = Components->Length++;
+        int Head = 0, Tail = 0;
+        Components->Labels[i] = Label;
+        Queue[Tail++] = i;
+
+        while (Head < Tail) {
+            int Index = Queue[Head++];
+            point Current = {Index / Grid->NumberCols, Index % Grid->NumberCols};
+
+            for (int k = 0; k < 4; k++) {
+                point Neighbour = {Current.Row + Directions[k][0], Current.Col + Directions[k][1]};
+                int NeighbourIndex = Neighbour.Row * Grid->NumberCols + Neighbour.Col;
+                if (!IsWalkable(Neighbour, Grid) || Components->Labels[NeighbourIndex] >= 0)
+                    continue;
+
+                Components->Labels[NeighbourIndex] = Label;
+                Queue[Tail++] = NeighbourIndex;
+            }
+        }
+    }
+
+    free(Queue);
+    Components->Version = Grid->Version;
+}
+
+/*
+    False only when a route from A to B certainly does not exist. With 
+    no up to date labels this cannot be told and the search decides.
+*/
+bool AreConnected(point A, point B, astar_grid *Grid) 
+{
+    if (!IsWalkable(A, Grid) || !IsWalkable(B, Grid))
+        return false;
+
+    components *Components = Grid->Components;
+    if (Components == NULL || Components->Version != Grid->Version)
+        return true;
+
+    return Components->Labels[A.Row * Grid->NumberCols + A.Col] == Components->Labels[B.Row * Grid->NumberCols + B.Col];
 }
 
-Tstack * PeekStack(Tstack **Stack) 
+void DestroyComponents(components *Components) 
 {
-    return (*Stack);
+    free(Components->Labels);
+    free(Components);
 }
 
-Tstack * PopStack(Tstack **Stack) 
+landmarks * CreateLandmarks(astar_grid *Grid, int Length) 
 {
-    Tstack *Temp = (*Stack);
-    (*Stack) = (*Stack)->next;
+    landmarks *Landmarks = (landmarks*) malloc(sizeof(landmarks));
+    Landmarks->Capacity = Length;
+    Landmarks->Length = 0;
+    Landmarks->CellsLength = Grid->NumberRows * Grid->NumberCols;
+    Landmarks->Points = (point*) malloc(Length * sizeof(point));
+    Landmarks->Distances = (int*) malloc(Length * Landmarks->CellsLength * sizeof(int));
+    BuildLandmarks(Landmarks, Grid);
 
-    return Temp;
+    return Landmarks;
 }
 
-void PrintStack(Tstack *Stack) 
+static int FarthestCell(int *Distances, int CellsLength) 
 {
-    Tstack *Temp = Stack;
-    while (Temp != NULL) {
-        DEBUG_PRINT("-> (%d,%d)", Temp->Data.Location.Row, Temp->Data.Location.Col);
-        Temp = Temp->next;
+    int Farthest = -1;
+    for (int i = 0; i < CellsLength; i++) {
+        if (Distances[i] >= 0 && (Farthest < 0 || Distances[i] > Distances[Farthest]))
+            Farthest = i;
     }
-    DEBUG_PRINT("\n");
+
+    return Farthest;
 }
 
-void DestroyStack(Tstack **Stack) 
+/*
+    Farthest-point placement: each new landmark is the open cell whose
+    road distance to the landmarks picked so far is largest, which puts
+    them on the edges of the map where their bounds are tightest.
+*/
+void BuildLandmarks(landmarks *Landmarks, astar_grid *Grid) 
 {
-    Tstack *Temp = NULL;
-    while((*Stack) != NULL) {
-        Temp = *Stack;
-        (*Stack) = (*Stack)->next;
-        free(Temp);
+    int *Queue = (int*) malloc(Landmarks->CellsLength * sizeof(int));
+    int *Nearest = (int*) malloc(Landmarks->CellsLength * sizeof(int));
+    int Next = -1;
+
+    for (int i = 0; i < Landmarks->CellsLength && Next < 0; i++) {
+        if (IsWalkable((point) {i / Grid->NumberCols, i % Grid->NumberCols}, Grid))
+            Next = i;
+    }
+
+    // start from the cell farthest away from an arbitrary open cell
+    if (Next >= 0) {
+        BreadthFirstDistances(Grid, (point) {Next / Grid->NumberCols, Next % Grid->NumberCols}, Nearest, Queue);
+        Next = FarthestCell(Nearest, Landmarks->CellsLength);
+    }
+
+    int Length = 0;
+    while (Length < Landmarks->Capacity && Next >= 0) {
+        int *Distances = &Landmarks->Distances[Length * Landmarks->CellsLength];
+        Landmarks->Points[Length] = (point) {Next / Grid->NumberCols, Next % Grid->NumberCols};
+        BreadthFirstDistances(Grid, Landmarks->Points[Length], Distances, Queue);
+
+        for (int i = 0; i < Landmarks->CellsLength; i++) {
+            if (Length == 0 || Distances[i] < Nearest[i])
+                Nearest[i] = Distances[i];
+        }
+
+        Length++;
+        Next = FarthestCell(Nearest, Landmarks->CellsLength);
+        if (Next >= 0 && Nearest[Next] == 0)
+            Next = -1;
     }
 
-   *Stack = NULL;
+    Landmarks->Length = Length;
+    Landmarks->Version = Grid->Version;
+    free(Nearest);
+    free(Queue);
 }
 
-Tstack * TracePath(point Dest, astar_grid *Grid) 
+void DestroyLandmarks(landmarks *Landmarks) 
 {
-    Tstack *stack = NULL;
- 
-    int r = Dest.Row;
-    int c = Dest.Col;
-    cell NextNode = {};
-    NextNode.Location.Row = r;
-    NextNode.Location.Col = c;
-
-    PushStack(&stack, NextNode);
+    free(Landmarks->Points);
+    free(Landmarks->Distances);
+    free(Landmarks);
+}
 
-    while(!(Grid->Map[r][c].Location.Row == r && Grid->Map[r][c].Location.Col == c)) {
-        NextNode.Location.Row = Grid->Map[r][c].Location.Row;
-        NextNode.Location.Col = Grid->Map[r][c].Location.Col;
-        PushStack(&stack, NextNode);
-        r = NextNode.Location.Row;
-        c = NextNode.Location.Col;
+void CloneQueue(Tqueue *Queue, Tqueue *Clone) 
+{
+    node *temp = Queue->head;
+    while(temp != NULL) {
+        PushQueue(Clone, temp->Data);
+        temp = temp->next;
     }
+}
 
-    return stack;
+static search_node * HeapCell(Theap *Heap, int i) 
+{
+    return &Heap->Scratch[Heap->Nodes[i].Row * Heap->NumberCols + Heap->Nodes[i].Col];
 }
 
-bool ElementIsInOpenList(Tqueue *Queue, cell Node) 
+static bool HeapLess(Theap *Heap, int i, int j) 
 {
-    node *Temp = Queue->head;
-    while (Temp != NULL) {
-        if (((cell*)((Temp)->Data))->f == Node.f 
-            && (((cell*)((Temp)->Data))->Location.Row == Node.Location.Row) 
-            && (((cell*)((Temp)->Data))->Location.Col == Node.Location.Col)) {
-            return true;
-        }
+    search_node *A = HeapCell(Heap, i);
+    search_node *B = HeapCell(Heap, j);
 
-        Temp = Temp->next;
+    if (A->f != B->f)
+        return A->f < B->f;
+    return A->h < B->h;
+}
+
+static void SwapHeapNodes(Theap *Heap, int i, int j) 
+{
+    point Temp = Heap->Nodes[i];
+    Heap->Nodes[i] = Heap->Nodes[j];
+    Heap->Nodes[j] = Temp;
+    HeapCell(Heap, i)->HeapIndex = i;
+    HeapCell(Heap, j)->HeapIndex = j;
+}
+
+static void SiftUpHeap(Theap *Heap, int i) 
+{
+    while (i > 0) {
+        int Parent = (i - 1) / 2;
+        if (!HeapLess(Heap, i, Parent))
+            break;
+        SwapHeapNodes(Heap, i, Parent);
+        i = Parent;
     }
+}
 
-    return false;
+static void SiftDownHeap(Theap *Heap, int i) 
+{
+    for (;;) {
+        int Smallest = i;
+        int Left = 2 * i + 1;
+        int Right = 2 * i + 2;
+
+        if (Left < Heap->Size && HeapLess(Heap, Left, Smallest))
+            Smallest = Left;
+        if (Right < Heap->Size && HeapLess(Heap, Right, Smallest))
+            Smallest = Right;
+        if (Smallest == i)
+            break;
+
+        SwapHeapNodes(Heap, i, Smallest);
+        i = Smallest;
+    }
 }
 
-Tstack * FindPath(point Start, point End, astar_grid *Grid) 
+void InitHeap(Theap *Heap, int Capacity, search_node *Scratch, int NumberCols) 
 {
-    if (Grid->IsOpenCellFunction(Start, Grid) == false || Grid->IsOpenCellFunction(End, Grid) == false) {
-        DEBUG_PRINTL("Source or Destination is blocked\n");
-        return NULL;
+    Heap->Nodes = (point*) malloc(Capacity * sizeof(point));
+    Heap->Size = 0;
+    Heap->Capacity = Capacity;
+    Heap->Scratch = Scratch;
+    Heap->NumberCols = NumberCols;
+}
+
+/* 
+    Every cell is in the heap at most once: the HeapIndex of its search
+    node is the slot it occupies, or -1 when it is not in the open list.
+*/
+void PushHeap(Theap *Heap, point Location) 
+{
+    if (Heap->Size >= Heap->Capacity) {
+        Heap->Capacity = Heap->Capacity > 0 ? Heap->Capacity * 2 : 64;
+        Heap->Nodes = (point*) realloc(Heap->Nodes, Heap->Capacity * sizeof(point));
     }
 
-    if (EqualPoints(Start, End)) {
-        DEBUG_PRINTL("We are already at the Destination\n");
-        return NULL;
+    int i = Heap->Size++;
+    Heap->Nodes[i] = Location;
+    HeapCell(Heap, i)->HeapIndex = i;
+    SiftUpHeap(Heap, i);
+}
+
+point PopHeap(Theap *Heap) 
+{
+    point Top = Heap->Nodes[0];
+    HeapCell(Heap, 0)->HeapIndex = -1;
+
+    Heap->Size--;
+    if (Heap->Size > 0) {
+        Heap->Nodes[0] = Heap->Nodes[Heap->Size];
+        HeapCell(Heap, 0)->HeapIndex = 0;
+        SiftDownHeap(Heap, 0);
     }
 
-    for (int i = 0; i < Grid->NumberRows; i++) {
-        for (int j = 0; j < Grid->NumberCols; j++) {
-            Grid->Map[i][j].f = -1;
-            Grid->Map[i][j].g = 0.0;
-            Grid->Map[i][j].h = 0.0;
-        }
+    return Top;
+}
+
+void DecreaseKeyHeap(Theap *Heap, point Location) 
+{
+    int i = Heap->Scratch[Location.Row * Heap->NumberCols + Location.Col].HeapIndex;
+    if (i < 0) {
+        PushHeap(Heap, Location);
+        return;
     }
-    point RefCoord = {Start.Row, Start.Col};
-    Grid->Map[Start.Row][Start.Col].Location.Row = RefCoord.Row;
-    Grid->Map[Start.Row][Start.Col].Location.Col = RefCoord.Col;
-    Grid->Map[Start.Row][Start.Col].f = 0.0;
-    Grid->Map[Start.Row][Start.Col].g = 0.0;
-    Grid->Map[Start.Row][Start.Col].h = 0.0;
 
-    Tqueue OpenList;
-    InitQueue(&OpenList, sizeof(cell), ComparePriority);
+    SiftUpHeap(Heap, i);
+}
 
-    bool ClosedList[Grid->NumberRows][Grid->NumberCols];
-    memset(ClosedList, false, sizeof(ClosedList));
+/*
+    Restores the heap order after the key of Location moved in either
+    direction, pushing it when it is not in the heap yet.
+*/
+void UpdateKeyHeap(Theap *Heap, point Location) 
+{
+    int i = Heap->Scratch[Location.Row * Heap->NumberCols + Location.Col].HeapIndex;
+    if (i < 0) {
+        PushHeap(Heap, Location);
+        return;
+    }
 
-    PushQueue(&OpenList, &Grid->Map[Start.Row][Start.Col]);
+    SiftUpHeap(Heap, i);
+    SiftDownHeap(Heap, Heap->Scratch[Location.Row * Heap->NumberCols + Location.Col].HeapIndex);
+}
 
-    while (!IsQueueEmpty(&OpenList)) {
-        cell PeekedCell;
-        PeekQueue(&OpenList, &PeekedCell);
-        RefCoord.Row = PeekedCell.Location.Row;
-        RefCoord.Col = PeekedCell.Location.Col;
-        PopQueue(&OpenList);
-        ClosedList[RefCoord.Row][RefCoord.Col] = true;
+void RemoveHeap(Theap *Heap, point Location) 
+{
+    int i = Heap->Scratch[Location.Row * Heap->NumberCols + Location.Col].HeapIndex;
+    if (i < 0)
+        return;
+
+    Heap->Size--;
+    if (i != Heap->Size) {
+        SwapHeapNodes(Heap, i, Heap->Size);
+        search_node *Moved = HeapCell(Heap, i);
+        SiftUpHeap(Heap, i);
+        SiftDownHeap(Heap, Moved->HeapIndex);
+    }
+    Heap->Scratch[Location.Row * Heap->NumberCols + Location.Col].HeapIndex = -1;
+}
+
+int IsHeapEmpty(Theap *Heap) 
+{
+    if (Heap->Size == 0) 
+        return 1;
+    return 0;
+}
+
+void DestroyHeap(Theap *Heap) 
+{
+    free(Heap->Nodes);
+    Heap->Nodes = NULL;
+    Heap->Size = 0;
+    Heap->Capacity = 0;
+}
+
+void InitBucketQueue(bucket_queue *Queue, int Length, bucket_node *Scratch) 
+{
+    Queue->Heads = (int*) malloc(Length * sizeof(int));
+    Queue->Length = Length;
+    Queue->Scratch = Scratch;
+    for (int i = 0; i < Length; i++) {
+        Queue->Heads[i] = -1;
+    }
+    Queue->Cursor = 0;
+    Queue->Top = -1;
+    Queue->Size = 0;
+}
+
+/*
+    A search that stops at its goal leaves nodes behind, but only in the
+    buckets from Cursor to Top.
+*/
+void ClearBuckets(bucket_queue *Queue) 
+{
+    for (int i = Queue->Cursor; i <= Queue->Top; i++) {
+        Queue->Heads[i] = -1;
+    }
+    Queue->Cursor = Queue->Length;
+    Queue->Top = -1;
+    Queue->Size = 0;
+}
+
+/*
+    Node goes in at the head of the bucket of its f, so among equal f
+    the newest node, usually the one deepest along its run, comes out
+    first.
+*/
+void PushBucket(bucket_queue *Queue, int Node) 
+{
+    bucket_node *Scratch = Queue->Scratch;
+    int f = Scratch[Node].f;
+
+    Scratch[Node].Prev = -1;
+    Scratch[Node].Next = Queue->Heads[f];
+    if (Queue->Heads[f] >= 0)
+        Scratch[Queue->Heads[f]].Prev = Node;
+    Queue->Heads[f] = Node;
+    Scratch[Node].Queued = true;
+
+    if (f < Queue->Cursor)
+        Queue->Cursor = f;
+    if (f > Queue->Top)
+        Queue->Top = f;
+    Queue->Size++;
+}
+
+int PopBucket(bucket_queue *Queue) 
+{
+    while (Queue->Heads[Queue->Cursor] < 0) {
+        Queue->Cursor++;
+    }
+
+    int Node = Queue->Heads[Queue->Cursor];
+    RemoveBucket(Queue, Node);
+    return Node;
+}
+
+void RemoveBucket(bucket_queue *Queue, int Node) 
+{
+    bucket_node *Scratch = Queue->Scratch;
+    if (!Scratch[Node].Queued)
+        return;
+
+    if (Scratch[Node].Prev >= 0)
+        Scratch[Scratch[Node].Prev].Next = Scratch[Node].Next;
+    else
+        Queue->Heads[Scratch[Node].f] = Scratch[Node].Next;
+    if (Scratch[Node].Next >= 0)
+        Scratch[Scratch[Node].Next].Prev = Scratch[Node].Prev;
+
+    Scratch[Node].Queued = false;
+    Queue->Size--;
+}
+
+void DestroyBucketQueue(bucket_queue *Queue) 
+{
+    free(Queue->Heads);
+    Queue->Heads = NULL;
+    Queue->Length = 0;
+    Queue->Size = 0;
+}
+
+void InitQueue(Tqueue *Queue, size_t memSize, compare_function Function)
+{
+   Queue->CompareFunction = Function;
+   Queue->memSize = memSize;
+   Queue->head  = NULL;
+}
+
+void PrintQueue(Tqueue *Queue) 
+{
+    node *Temp = Queue->head;
+    while (Temp != NULL) {
+        DEBUG_PRINT("(%d %d)->", ((cell*)((Temp)->Data))->Location.Row, ((cell*)((Temp)->Data))->Location.Col);
+        Temp = Temp->next;
+    }
+}
+
+void PushQueue(Tqueue *Queue, void* data) 
+{
+    node *newNode = (node*) malloc(sizeof(node));
+    node *temp = Queue->head;
+
+    if(newNode == NULL) {
+        return -1;
+    }
+
+    newNode->Data = malloc(Queue->memSize);
+
+    if(newNode->Data == NULL) {
+        free(newNode);
+        return -1;
+    }
+
+    newNode->next = NULL;
+
+    memcpy(newNode->Data, data, Queue->memSize);
+
+    if(IsQueueEmpty(Queue)) {
+        Queue->head  = newNode;
+    } else {
+        if (Queue->CompareFunction == NULL) {
+            while (temp->next != NULL) {
+                temp = temp->next;
+            }
+            
+            newNode->next = temp->next;
+            temp->next = newNode;
+            return;
+        }
+
+        if (Queue->CompareFunction((void*)(temp), data) == 1) {
+            newNode->next = Queue->head;
+            Queue->head = newNode;
+        } else {
+            while (temp->next != NULL && Queue->CompareFunction((void*)(temp), data) == 0) {
+                temp = temp->next;
+            }
+
+            newNode->next = temp->next;
+            temp->next = newNode;
+        }
+    }
+}
+
+void PeekQueue(Tqueue *Queue, void *data) 
+{
+   if(!IsQueueEmpty(Queue)) {
+       node *temp = Queue->head;
+       memcpy(data, temp->Data, Queue->memSize);
+    }
+}
+
+void PopQueue(Tqueue *Queue) 
+{ 
+    if(!IsQueueEmpty(Queue)) {
+        node *temp = Queue->head;
+        // memcpy(data, temp->data, Queue->memSize);
+
+        if(Queue->head->next != NULL) {
+            Queue->head = Queue->head->next;
+        } else {
+            Queue->head = NULL;
+        }
+
+        free(temp->Data);
+        free(temp);
+    }
+}
+
+int IsQueueEmpty(Tqueue *Queue) 
+{
+    if (Queue->head == NULL) 
+        return 1;
+    return 0;
+}
+
+void DestroyQueue(Tqueue *Queue) 
+{
+    node *temp;
+
+     while(!IsQueueEmpty(Queue)) {
+        temp = Queue->head;
+        Queue->head = temp->next;
+        free(temp->Data);
+        free(temp);
+    }
+
+    Queue->head = NULL;
+}
+
+Tpath * NewPath(int Length) 
+{
+    Tpath *Path = (Tpath*) malloc(sizeof(Tpath) + Length * sizeof(path_point));
+    Path->Length = Length;
+    Path->Cursor = 0;
+
+    return Path;
+}
+
+/*
+    Copies the points of Path that have not been popped yet.
+*/
+Tpath * CopyPath(Tpath *Path) 
+{
+    if (Path == NULL)
+        return NULL;
+
+    Tpath *Copy = NewPath(PathLength(Path));
+    memcpy(Copy->Points, &Path->Points[Path->Cursor], Copy->Length * sizeof(path_point));
+
+    return Copy;
+}
+
+point GetPathPoint(Tpath *Path, int i) 
+{
+    return (point) {Path->Points[i].Row, Path->Points[i].Col};
+}
+
+point PeekPath(Tpath *Path) 
+{
+    return GetPathPoint(Path, Path->Cursor);
+}
+
+point PopPath(Tpath *Path) 
+{
+    return GetPathPoint(Path, Path->Cursor++);
+}
+
+int PathLength(Tpath *Path) 
+{
+    if (Path == NULL)
+        return 0;
+    return Path->Length - Path->Cursor;
+}
+
+/*
+    Number of cells the rest of the path drives over.
+*/
+int PathDistance(Tpath *Path) 
+{
+    int Distance = 0;
+    for (int i = Path != NULL ? Path->Cursor + 1 : 0; Path != NULL && i < Path->Length; i++) {
+        point From = GetPathPoint(Path, i - 1), To = GetPathPoint(Path, i);
+        Distance += abs(From.Row - To.Row) + abs(From.Col - To.Col);
+    }
+
+    return Distance;
+}
+
+int IsPathEmpty(Tpath *Path) 
+{
+    if (Path == NULL || Path->Cursor >= Path->Length) 
+        return 1;
+    return 0;
+}
+
+static point RunDirection(point From, point To) 
+{
+    return (point) {(To.Row > From.Row) - (To.Row < From.Row), (To.Col > From.Col) - (To.Col < From.Col)};
+}
+
+static bool IsStraightRun(path_point A, path_point B, path_point C) 
+{
+    point From = {A.Row, A.Col}, Corner = {B.Row, B.Col}, To = {C.Row, C.Col};
+    return EqualPoints(RunDirection(From, Corner), RunDirection(Corner, To));
+}
+
+/*
+    Segments run along a single row or column, so the bounding box of
+    From and To is the segment itself.
+*/
+bool IsOnSegment(point From, point To, point Location) 
+{
+    return (Location.Row - From.Row) * (Location.Row - To.Row) <= 0 
+        && (Location.Col - From.Col) * (Location.Col - To.Col) <= 0;
+}
+
+/*
+    Looks at every cell the rest of the path drives over, starting at 
+    the next corner.
+*/
+bool PathContains(Tpath *Path, point Location) 
+{
+    for (int i = Path != NULL ? Path->Cursor : 0; Path != NULL && i < Path->Length; i++) {
+        point From = GetPathPoint(Path, i > Path->Cursor ? i - 1 : i);
+        if (IsOnSegment(From, GetPathPoint(Path, i), Location))
+            return true;
+    }
+
+    return false;
+}
+
+/*
+    Drops every point of a path that sits in the middle of a straight
+    run, keeping the start, the corners and the destination. Returns
+    the shrunk buffer.
+*/
+Tpath * CompressPath(Tpath *Path) 
+{
+    if (Path == NULL || Path->Length < 3)
+        return Path;
+
+    int Length = 1;
+    for (int i = 1; i < Path->Length; i++) {
+        if (Length >= 2 && IsStraightRun(Path->Points[Length - 2], Path->Points[Length - 1], Path->Points[i]))
+            Path->Points[Length - 1] = Path->Points[i];
+        else
+            Path->Points[Length++] = Path->Points[i];
+    }
+
+    Path->Length = Length;
+    return (Tpath*) realloc(Path, sizeof(Tpath) + Length * sizeof(path_point));
+}
+
+/*
+    Moves what is left of Path and all of Tail into one buffer, dropping
+    Tail's first point when it repeats the last one of Path, and the 
+    joint itself when the two runs meeting there go the same way. Takes
+    ownership of Tail.
+*/
+void AppendPath(Tpath **Path, Tpath *Tail) 
+{
+    if (IsPathEmpty(*Path)) {
+        DestroyPath(Path);
+        *Path = Tail;
+        return;
+    }
+
+    if (Tail == NULL)
+        return;
+
+    int Skip = 0;
+    if (!IsPathEmpty(Tail) && EqualPoints(GetPathPoint(*Path, (*Path)->Length - 1), PeekPath(Tail)))
+        Skip = 1;
+
+    int HeadLength = PathLength(*Path);
+    int TailLength = PathLength(Tail) - Skip;
+    Tpath *Joined = NewPath(HeadLength + TailLength);
+    memcpy(Joined->Points, &(*Path)->Points[(*Path)->Cursor], HeadLength * sizeof(path_point));
+    memcpy(&Joined->Points[HeadLength], &Tail->Points[Tail->Cursor + Skip], TailLength * sizeof(path_point));
+
+    int Joint = HeadLength - 1;
+    if (Joint >= 1 && Joint + 1 < Joined->Length && IsStraightRun(Joined->Points[Joint - 1], Joined->Points[Joint], Joined->Points[Joint + 1])) {
+        memmove(&Joined->Points[Joint], &Joined->Points[Joint + 1], (Joined->Length - Joint - 1) * sizeof(path_point));
+        Joined->Length--;
+    }
+
+    DestroyPath(Path);
+    DestroyPath(&Tail);
+    *Path = Joined;
+}
+
+void PrintPath(Tpath *Path) 
+{
+    for (int i = Path->Cursor; i < Path->Length; i++) {
+        DEBUG_PRINT("-> (%d,%d)", Path->Points[i].Row, Path->Points[i].Col);
+    }
+    DEBUG_PRINT("\n");
+}
+
+void DestroyPath(Tpath **Path) 
+{
+    free(*Path);
+    *Path = NULL;
+}
+
+/*
+    Parents are usually adjacent cells, but jump point search links cells
+    that are a straight run apart. Only the corners are written out, 
+    from the back: a parent goes in when the run through it turns. 
+    Without a Path the corners are only counted.
+*/
+static int TraceCorners(point Dest, astar_search *Search, Tpath *Path) 
+{
+    int Length = 0;
+    if (Path != NULL)
+        Path->Points[Path->Length - 1] = (path_point) {Dest.Row, Dest.Col};
+    Length++;
+
+    point Current = Dest;
+    point Heading = {0, 0};
+    point Parent = GetNode(Current, Search)->Parent;
+    while (!EqualPoints(Parent, Current)) {
+        point Run = RunDirection(Current, Parent);
+        if (!EqualPoints(Current, Dest) && !EqualPoints(Run, Heading)) {
+            if (Path != NULL)
+                Path->Points[Path->Length - 1 - Length] = (path_point) {Current.Row, Current.Col};
+            Length++;
+        }
+
+        Heading = Run;
+        Current = Parent;
+        Parent = GetNode(Current, Search)->Parent;
+    }
+
+    if (!EqualPoints(Current, Dest)) {
+        if (Path != NULL)
+            Path->Points[0] = (path_point) {Current.Row, Current.Col};
+        Length++;
+    }
+
+    return Length;
+}
+
+Tpath * TracePath(point Dest, astar_search *Search) 
+{
+    Tpath *Path = NewPath(TraceCorners(Dest, Search, NULL));
+    TraceCorners(Dest, Search, Path);
+
+    return Path;
+}
+
+static bool IsWalkable(point Location, astar_grid *Grid) 
+{
+    if (Location.Row < 0 || Location.Row >= Grid->NumberRows || Location.Col < 0 || Location.Col >= Grid->NumberCols)
+        return false;
+    return Grid->IsOpenCellFunction(Location, Grid);
+}
+
+/* 
+    A side cell that is open right after a wall can only be reached
+    optimally by turning at Current.
+*/
+static bool HasForcedNeighbour(point Current, int dRow, int dCol, astar_grid *Grid) 
+{
+    for (int Side = -1; Side <= 1; Side += 2) {
+        point Neighbour = {Current.Row + Side * dCol, Current.Col + Side * dRow};
+        point Behind = {Neighbour.Row - dRow, Neighbour.Col - dCol};
+        if (IsWalkable(Neighbour, Grid) && !IsWalkable(Behind, Grid))
+            return true;
+    }
+
+    return false;
+}
+
+/*
+    Horizontal runs stop at the goal or at a forced neighbour. Vertical
+    runs also stop wherever a horizontal run would find a jump point, so
+    every turn of a route lands on a cell that goes into the open list.
+*/
+static bool Jump(point From, int dRow, int dCol, point End, astar_grid *Grid, point *JumpPoint) 
+{
+    point Current = From;
+    point Unused;
+
+    for (;;) {
+        Current.Row += dRow;
+        Current.Col += dCol;
+
+        if (!IsWalkable(Current, Grid))
+            return false;
+
+        if (EqualPoints(Current, End) || HasForcedNeighbour(Current, dRow, dCol, Grid))
+            break;
+
+        if (dRow != 0 && (Jump(Current, 0, -1, End, Grid, &Unused) || Jump(Current, 0, 1, End, Grid, &Unused)))
+            break;
+    }
+
+    *JumpPoint = Current;
+    return true;
+}
+
+static Tpath * FindPathJPS(point Start, point End, astar_grid *Grid, astar_search *Search) 
+{
+    const int Directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+    BeginSearch(Search);
+
+    search_node *StartNode = TouchNode(Start, Search);
+    StartNode->Parent = Start;
+    StartNode->g = 0.0;
+    StartNode->h = EstimateDistance(Start, End, Grid, Search);
+    StartNode->f = StartNode->h;
+
+    Theap *OpenList = &Search->OpenList;
+    PushHeap(OpenList, Start);
+
+    while (!IsHeapEmpty(OpenList)) {
+        point RefCoord = PopHeap(OpenList);
+        search_node *RefNode = GetNode(RefCoord, Search);
+        RefNode->Closed = true;
+        Search->Expanded++;
+
+        if (EqualPoints(RefCoord, End))
+            return TracePath(End, Search);
+
+        for (int k = 0; k < 4; k++) {
+            int dRow = Directions[k][0];
+            int dCol = Directions[k][1];
+
+            // never jump straight back towards the parent
+            if ((RefNode->Parent.Row - RefCoord.Row) * dRow > 0 || (RefNode->Parent.Col - RefCoord.Col) * dCol > 0)
+                continue;
+
+            point JumpPoint;
+            if (!Jump(RefCoord, dRow, dCol, End, Grid, &JumpPoint))
+                continue;
+
+            search_node *JumpNode = TouchNode(JumpPoint, Search);
+            if (JumpNode->Closed)
+                continue;
+
+            double gNew = RefNode->g + abs(JumpPoint.Row - RefCoord.Row) + abs(JumpPoint.Col - RefCoord.Col);
+            if (JumpNode->f < 0 || gNew < JumpNode->g) {
+                JumpNode->g = gNew;
+                JumpNode->h = EstimateDistance(JumpPoint, End, Grid, Search);
+                JumpNode->f = gNew + JumpNode->h;
+                JumpNode->Parent = RefCoord;
+                DecreaseKeyHeap(OpenList, JumpPoint);
+            }
+        }
+    }
+
+    DEBUG_PRINT("Failed to find the Destination Cell\n");
+    return NULL;
+}
+
+/*
+    Glues the forward half (Start -> Meet) to the backward half 
+    (Meet -> End), whose parents point towards End.
+*/
+static Tpath * TraceBidirectionalPath(point Meet, astar_search *Search) 
+{
+    Tpath *Forward = TracePath(Meet, Search);
+
+    int ReverseLength = 0;
+    point Current = Meet;
+    search_node *Node = TouchReverseNode(Current, Search);
+    while (!EqualPoints(Node->Parent, Current)) {
+        Current = Node->Parent;
+        Node = TouchReverseNode(Current, Search);
+        ReverseLength++;
+    }
+
+    Tpath *Path = NewPath(Forward->Length + ReverseLength);
+    memcpy(Path->Points, Forward->Points, Forward->Length * sizeof(path_point));
+
+    int i = Forward->Length;
+    Current = Meet;
+    Node = TouchReverseNode(Current, Search);
+    while (!EqualPoints(Node->Parent, Current)) {
+        Current = Node->Parent;
+        Node = TouchReverseNode(Current, Search);
+        Path->Points[i++] = (path_point) {Current.Row, Current.Col};
+    }
+
+    DestroyPath(&Forward);
+    return CompressPath(Path);
+}
+
+/*
+    Runs A* from both ends, each frontier aiming at the other end, and 
+    always grows the smaller open list. Every edge that links the two
+    trees is a candidate route; the best one is final as soon as either
+    frontier's lowest f reaches its length, since with a consistent 
+    heuristic that f bounds every route still to be found.
+*/
+static Tpath * FindPathBidirectional(point Start, point End, astar_grid *Grid, astar_search *Search) 
+{
+    const int Directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+    UseReverseNodes(Search);
+    BeginSearch(Search);
+
+    search_node *StartNode = TouchNode(Start, Search);
+    StartNode->Parent = Start;
+    StartNode->h = EstimateDistance(Start, End, Grid, Search);
+    StartNode->f = StartNode->h;
+    PushHeap(&Search->OpenList, Start);
+
+    search_node *EndNode = TouchReverseNode(End, Search);
+    EndNode->Parent = End;
+    EndNode->h = StartNode->h;
+    EndNode->f = EndNode->h;
+    PushHeap(&Search->ReverseOpenList, End);
+
+    double BestLength = -1;
+    point Meet = Start;
+
+    while (!IsHeapEmpty(&Search->OpenList) && !IsHeapEmpty(&Search->ReverseOpenList)) {
+        point ForwardTop = Search->OpenList.Nodes[0];
+        point BackwardTop = Search->ReverseOpenList.Nodes[0];
+        if (BestLength >= 0 && (GetNode(ForwardTop, Search)->f >= BestLength || 
+                                TouchReverseNode(BackwardTop, Search)->f >= BestLength))
+            break;
+
+        bool Forward = Search->OpenList.Size <= Search->ReverseOpenList.Size;
+        Theap *OpenList = Forward ? &Search->OpenList : &Search->ReverseOpenList;
+        point Target = Forward ? End : Start;
+
+        point RefCoord = PopHeap(OpenList);
+        search_node *RefNode = Forward ? GetNode(RefCoord, Search) : TouchReverseNode(RefCoord, Search);
+        RefNode->Closed = true;
+        Search->Expanded++;
+
+        for (int k = 0; k < 4; k++) {
+            point Neighbour = {RefCoord.Row + Directions[k][0], RefCoord.Col + Directions[k][1]};
+            if (!IsWalkable(Neighbour, Grid))
+                continue;
+
+            search_node *NeighbourNode = Forward ? TouchNode(Neighbour, Search) : TouchReverseNode(Neighbour, Search);
+            if (NeighbourNode->Closed)
+                continue;
+
+            double gNew = RefNode->g + 1.0;
+            if (NeighbourNode->f < 0 || gNew < NeighbourNode->g) {
+                NeighbourNode->g = gNew;
+                NeighbourNode->h = EstimateDistance(Neighbour, Target, Grid, Search);
+                NeighbourNode->f = gNew + NeighbourNode->h;
+                NeighbourNode->Parent = RefCoord;
+                DecreaseKeyHeap(OpenList, Neighbour);
+
+                search_node *Other = NULL;
+                if (Forward && WasReachedBackward(Neighbour, Search))
+                    Other = TouchReverseNode(Neighbour, Search);
+                else if (!Forward && GetNode(Neighbour, Search)->Stamp == Search->SearchId && GetNode(Neighbour, Search)->f >= 0)
+                    Other = GetNode(Neighbour, Search);
+
+                if (Other && (BestLength < 0 || gNew + Other->g < BestLength)) {
+                    BestLength = gNew + Other->g;
+                    Meet = Neighbour;
+                }
+            }
+        }
+    }
+
+    if (BestLength < 0) {
+        DEBUG_PRINT("Failed to find the Destination Cell\n");
+        return NULL;
+    }
+
+    return TraceBidirectionalPath(Meet, Search);
+}
+
+/*
+    The checks every search runs before it expands anything.
+*/
+bool IsPathPossible(point Start, point End, astar_grid *Grid) 
+{
+    if (Grid->IsOpenCellFunction(Start, Grid) == false || Grid->IsOpenCellFunction(End, Grid) == false) {
+        DEBUG_PRINTL("Source or Destination is blocked\n");
+        return false;
+    }
+
+    if (EqualPoints(Start, End)) {
+        DEBUG_PRINTL("We are already at the Destination\n");
+        return false;
+    }
+
+    if (!AreConnected(Start, End, Grid)) {
+        DEBUG_PRINTL("Destination is not connected to Source\n");
+        return false;
+    }
+
+    return true;
+}
+
+Tpath * FindPath(point Start, point End, astar_grid *Grid, astar_search *Search) 
+{
+    // already there: the one cell, the same route StartPathSearch gives
+    if (EqualPoints(Start, End) && Grid->IsOpenCellFunction(Start, Grid)) {
+        Tpath *Path = NewPath(1);
+        Path->Points[0] = (path_point) {Start.Row, Start.Col};
+        return Path;
+    }
+
+    if (!IsPathPossible(Start, End, Grid))
+        return NULL;
+
+    switch (Search->Mode) {
+        case SEARCH_MODE_JPS:
+            return FindPathJPS(Start, End, Grid, Search);
+
+        case SEARCH_MODE_BIDIRECTIONAL:
+            return FindPathBidirectional(Start, End, Grid, Search);
+
+        case SEARCH_MODE_HIERARCHICAL:
+            return FindPathHierarchical(Start, End, Grid, Search);
+
+        case SEARCH_MODE_ROAD_GRAPH:
+            return FindPathRoadGraph(Start, End, Grid, Search);
+
+        case SEARCH_MODE_CONTRACTION:
+            return FindPathContracted(Start, End, Grid, Search);
+
+        case SEARCH_MODE_ANYTIME:
+            return FindPathAnytime(Start, End, Grid, Search);
+
+        case SEARCH_MODE_BUCKET:
+            return FindPathBucket(Start, End, Grid, Search);
+
+        default:
+            return FindPathAStar(Start, End, Grid, Search);
+    }
+}
+
+/* FindPath has checked the route is possible already. */
+static Tpath * FindPathAStar(point Start, point End, astar_grid *Grid, astar_search *Search) 
+{
+    SeedPathSearch(Start, End, Grid, Search);
+    ContinuePathSearch(Grid, Search, INT_MAX);
+    return FinishPathSearch(Search);
+}
+
+/*
+    How many times longer than the shortest route one of Cost can be. 
+    The shortest still has to go through the open list or Incons (the
+    nodes waiting to be reopened), so the smallest g + h found there, or
+    Lower, is a lower bound on it.
+*/
+static double SuboptimalityBound(astar_search *Search, astar_grid *Grid, double Cost, double Lower, point *Incons, int InconsLength)
+{
+    Theap *OpenList = &Search->OpenList;
+    for (int i = 0; i < OpenList->Size; i++) {
+        search_node *Node = HeapCell(OpenList, i);
+        Lower = fmin(Lower, Node->g + Node->h);
+    }
+    for (int i = 0; i < InconsLength; i++) {
+        search_node *Node = GetNode(Incons[i], Search);
+        Lower = fmin(Lower, Node->g + Node->h);
+    }
+
+    // the start node carries no h, but the straight distance is a bound too
+    Lower = fmax(Lower, EstimateDistance(Search->Start, Search->End, Grid, Search));
+    return Lower >= Cost ? 1.0 : Cost / Lower;
+}
+
+static void SeedPathSearch(point Start, point End, astar_grid *Grid, astar_search *Search) 
+{
+    BeginSearch(Search);
+    Search->Start = Start;
+    Search->End = End;
+    Search->Version = Grid->Version;
+    Search->Status = SEARCH_RUNNING;
+    Search->InconsLower = INFINITY;
+
+    search_node *StartNode = TouchNode(Start, Search);
+    StartNode->Parent = Start;
+    StartNode->f = 0.0;
+    StartNode->g = 0.0;
+    StartNode->h = 0.0;
+    PushHeap(&Search->OpenList, Start);
+}
+
+/*
+    A* split into slices: StartPathSearch only seeds the open list, and
+    every ContinuePathSearch expands at most Budget nodes, keeping the 
+    open list and node scratch in Search for the next call. A Start
+    that is End already is found at once, as a route of that one cell.
+*/
+void StartPathSearch(point Start, point End, astar_grid *Grid, astar_search *Search) 
+{
+    SeedPathSearch(Start, End, Grid, Search);
+    if (EqualPoints(Start, End) && Grid->IsOpenCellFunction(Start, Grid))
+        Search->Status = SEARCH_FOUND;
+    else if (!IsPathPossible(Start, End, Grid))
+        Search->Status = SEARCH_FAILED;
+}
+
+search_status ContinuePathSearch(astar_grid *Grid, astar_search *Search, int Budget) 
+{
+    if (Search->Status != SEARCH_RUNNING)
+        return Search->Status;
+
+    // the map changed between two slices, so what was settled may be wrong
+    if (Search->Version != Grid->Version)
+        StartPathSearch(Search->Start, Search->End, Grid, Search);
+
+    point End = Search->End;
+    Theap *OpenList = &Search->OpenList;
+    double Weight = Search->Mode == SEARCH_MODE_WEIGHTED ? fmax(Search->Weight, 1.0) : 1.0;
+
+    for (int Expanded = 0; Expanded < Budget; Expanded++) {
+        if (IsHeapEmpty(OpenList)) {
+            DEBUG_PRINT("Failed to find the Destination Cell\n");
+            Search->Status = SEARCH_FAILED;
+            return Search->Status;
+        }
+
+        point RefCoord = PopHeap(OpenList);
+        search_node *RefNode = GetNode(RefCoord, Search);
+        RefNode->Closed = true;
+        Search->Expanded++;
 
         /*
                 Generating all the 4 successor of this cell
@@ -336,28 +1615,33 @@ Tstack * FindPath(point Start, point End, astar_grid *Grid)
                 point Neighbour = {RefCoord.Row + add_Row, RefCoord.Col + add_Col};
                 if (IsNeighbour(RefCoord, Neighbour, Grid)) {
                     if (EqualPoints(Neighbour, End)) {
-                        Grid->Map[Neighbour.Row][Neighbour.Col].Location.Row = RefCoord.Row;
-                        Grid->Map[Neighbour.Row][Neighbour.Col].Location.Col = RefCoord.Col;
+                        TouchNode(End, Search)->Parent = RefCoord;
                         // printf("The Destination cell has been found\n");
-                        Tstack *FinalPath  = TracePath(End, Grid);
-                        DestroyQueue(&OpenList);
-                        return FinalPath;
-                    } else if (!ClosedList[Neighbour.Row][Neighbour.Col] && (Grid->IsOpenCellFunction(Neighbour, Grid) == true)) {
-                        double fNew = CalculateHeuristic(Neighbour, End, Grid->Map[RefCoord.Row][RefCoord.Col]);
-
-                        if (Grid->Map[Neighbour.Row][Neighbour.Col].f > fNew || 
-                            Grid->Map[Neighbour.Row][Neighbour.Col].f < 0) {
-                            
-                            Grid->Map[Neighbour.Row][Neighbour.Col].Location.Row = Neighbour.Row;
-                            Grid->Map[Neighbour.Row][Neighbour.Col].Location.Col = Neighbour.Col;
-                            Grid->Map[Neighbour.Row][Neighbour.Col].f = fNew;
-                            PushQueue(&OpenList, &Grid->Map[Neighbour.Row][Neighbour.Col]);
-
-                            // Update the details of this cell
-                            Grid->Map[Neighbour.Row][Neighbour.Col].g = Grid->Map[RefCoord.Row][RefCoord.Col].g + 1.0;
-                            Grid->Map[Neighbour.Row][Neighbour.Col].h = (abs(Neighbour.Row - End.Row) + abs(Neighbour.Col - End.Col));;
-                            Grid->Map[Neighbour.Row][Neighbour.Col].Location.Row = RefCoord.Row;
-                            Grid->Map[Neighbour.Row][Neighbour.Col].Location.Col = RefCoord.Col;
+                        Search->Bound = 1.0;
+                        if (Search->Mode == SEARCH_MODE_WEIGHTED)
+                            Search->Bound = fmin(Weight, SuboptimalityBound(Search, Grid, RefNode->g + 1.0, fmin(RefNode->g + RefNode->h, Search->InconsLower), NULL, 0));
+                        Search->Status = SEARCH_FOUND;
+                        return Search->Status;
+                    } else if (Grid->IsOpenCellFunction(Neighbour, Grid) == true) {
+                        search_node *NeighbourNode = TouchNode(Neighbour, Search);
+                        if (NeighbourNode->Closed) {
+                            // only an inflated h closes a node too early; it is not
+                            // reopened, but the bound has to count the cheaper way in
+                            if (NeighbourNode->g > RefNode->g + 1.0)
+                                Search->InconsLower = fmin(Search->InconsLower, RefNode->g + 1.0 + NeighbourNode->h);
+                            continue;
+                        }
+
+                        double hNew = EstimateDistance(Neighbour, End, Grid, Search);
+                        double fNew = RefNode->g + 1.0 + Weight * hNew;
+
+                        if (NeighbourNode->f > fNew || NeighbourNode->f < 0) {
+                            // Update the details of this cell, then fix its place in the open list
+                            NeighbourNode->f = fNew;
+                            NeighbourNode->g = RefNode->g + 1.0;
+                            NeighbourNode->h = hNew;
+                            NeighbourNode->Parent = RefCoord;
+                            DecreaseKeyHeap(OpenList, Neighbour);
                         }
                     }
                 }
@@ -365,6 +1649,381 @@ Tstack * FindPath(point Start, point End, astar_grid *Grid)
         }
     }
 
-    DEBUG_PRINT("Failed to find the Destination Cell\n");
+    return Search->Status;
+}
+
+/*
+    Hands back the path of a finished sliced search (NULL when it failed)
+    and leaves Search free for the next one.
+*/
+Tpath * FinishPathSearch(astar_search *Search) 
+{
+    search_status Status = Search->Status;
+    Search->Status = SEARCH_IDLE;
+    if (Status != SEARCH_FOUND)
+        return NULL;
+
+    return TracePath(Search->End, Search);
+}
+
+/*
+    ARA*: a weighted A* that, once it has a route, lowers the weight by 
+    ANYTIME_WEIGHT_STEP and searches again on top of the g values it
+    already has, until the weight reaches 1 or AnytimeBudget expansions
+    (0 for no limit) are spent after the first route. Nodes that got 
+    cheaper after their expansion wait in Incons, marked by a HeapIndex
+    of -2, to be reopened by the next round.
+*/
+static Tpath * FindPathAnytime(point Start, point End, astar_grid *Grid, astar_search *Search) 
+{
+    BeginSearch(Search);
+    Search->Start = Start;
+    Search->End = End;
+
+    int CellsLength = Grid->NumberRows * Grid->NumberCols;
+    point *Incons = UseCellLists(Search);
+    point *Closed = Incons + CellsLength;
+    int InconsLength = 0, ClosedLength = 0, Spent = 0;
+    Theap *OpenList = &Search->OpenList;
+    double Weight = fmax(Search->Weight, 1.0);
+
+    search_node *StartNode = TouchNode(Start, Search);
+    StartNode->Parent = Start;
+    StartNode->g = 0.0;
+    StartNode->h = EstimateDistance(Start, End, Grid, Search);
+    StartNode->f = Weight * StartNode->h;
+    PushHeap(OpenList, Start);
+
+    Tpath *Path = NULL;
+    bool OutOfBudget = false;
+    double Proven = INFINITY;
+    for (;;) {
+        // the route is settled once nothing left open could lead to a cheaper one
+        while (!IsHeapEmpty(OpenList)) {
+            search_node *EndNode = TouchNode(End, Search);
+            if (EndNode->f >= 0 && EndNode->g <= HeapCell(OpenList, 0)->f)
+                break;
+
+            if (Path != NULL && Search->AnytimeBudget > 0 && Spent >= Search->AnytimeBudget) {
+                OutOfBudget = true;
+                break;
+            }
+
+            point RefCoord = PopHeap(OpenList);
+            search_node *RefNode = GetNode(RefCoord, Search);
+            RefNode->Closed = true;
+            Closed[ClosedLength++] = RefCoord;
+            Search->Expanded++;
+            Spent++;
+
+            for (int add_Row = -1; add_Row <= 1; add_Row++) {
+                for (int add_Col = -1; add_Col <= 1; add_Col++) {
+                    point Neighbour = {RefCoord.Row + add_Row, RefCoord.Col + add_Col};
+                    if (!IsNeighbour(RefCoord, Neighbour, Grid) || Grid->IsOpenCellFunction(Neighbour, Grid) == false)
+                        continue;
+
+                    search_node *NeighbourNode = TouchNode(Neighbour, Search);
+                    if (NeighbourNode->f >= 0 && NeighbourNode->g <= RefNode->g + 1.0)
+                        continue;
+
+                    if (NeighbourNode->f < 0)
+                        NeighbourNode->h = EstimateDistance(Neighbour, End, Grid, Search);
+                    NeighbourNode->g = RefNode->g + 1.0;
+                    NeighbourNode->f = NeighbourNode->g + Weight * NeighbourNode->h;
+                    NeighbourNode->Parent = RefCoord;
+
+                    if (!NeighbourNode->Closed) {
+                        DecreaseKeyHeap(OpenList, Neighbour);
+                    } else if (NeighbourNode->HeapIndex != -2) {
+                        NeighbourNode->HeapIndex = -2;
+                        Incons[InconsLength++] = Neighbour;
+                    }
+                }
+            }
+        }
+
+        search_node *EndNode = TouchNode(End, Search);
+        if (EndNode->f < 0)
+            break;
+
+        // parents always chain back to Start, so even a round cut short leaves a route,
+        // but only a finished round holds to its weight
+        if (!OutOfBudget)
+            Proven = Weight;
+        if (Path == NULL)
+            Spent = 0;
+        DestroyPath(&Path);
+        Path = TracePath(End, Search);
+        Search->Bound = fmin(Proven, SuboptimalityBound(Search, Grid, EndNode->g, INFINITY, Incons, InconsLength));
+        DEBUG_PRINTL("Anytime route of %.0f cells with weight %.2f, bound %.3f\n", EndNode->g, Weight, Search->Bound);
+
+        if (OutOfBudget || Weight <= 1.0 || Search->Bound <= 1.0)
+            break;
+
+        // next round: Incons joins the open list, everything is open again and keyed by the new weight
+        Weight = fmax(Weight - ANYTIME_WEIGHT_STEP, 1.0);
+        for (int i = 0; i < ClosedLength; i++) {
+            GetNode(Closed[i], Search)->Closed = false;
+        }
+        ClosedLength = 0;
+
+        for (int i = 0; i < OpenList->Size; i++) {
+            Incons[InconsLength++] = OpenList->Nodes[i];
+        }
+        OpenList->Size = 0;
+        for (int i = 0; i < InconsLength; i++) {
+            search_node *Node = GetNode(Incons[i], Search);
+            Node->HeapIndex = -1;
+            Node->f = Node->g + Weight * Node->h;
+            PushHeap(OpenList, Incons[i]);
+        }
+        InconsLength = 0;
+    }
+
+    return Path;
+}
+
+static const int BucketMoves[4][2] = {{-1, 0}, {0, -1}, {0, 1}, {1, 0}};
+
+static Tpath * TraceBucketPath(astar_search *Search, int End) 
+{
+    bucket_node *Nodes = Search->BucketNodes;
+    Tpath *Path = NewPath(Nodes[End].g + 1);
+    for (int Cell = End, i = Path->Length - 1; i >= 0; i--) {
+        Path->Points[i] = (path_point) {Cell / Search->NumberCols, Cell % Search->NumberCols};
+        Cell = Nodes[Cell].Parent;
+    }
+
+    return CompressPath(Path);
+}
+
+/*
+    A* on integer g and f with the bucket queue for an open list, so a
+    push or a pop costs O(1) instead of the log of the heap. Finds 
+    routes as short as FindPathAStar's; only ties between equally long
+    ones can go another way.
+*/
+static Tpath * FindPathBucket(point Start, point End, astar_grid *Grid, astar_search *Search) 
+{
+    UseBucketNodes(Search);
+    BeginSearch(Search);
+    ClearBuckets(&Search->Buckets);
+
+    bucket_queue *OpenList = &Search->Buckets;
+    bucket_node *Nodes = Search->BucketNodes;
+    int StartCell = Start.Row * Grid->NumberCols + Start.Col;
+    int EndCell = End.Row * Grid->NumberCols + End.Col;
+
+    bucket_node *StartNode = &Nodes[StartCell];
+    StartNode->Stamp = Search->SearchId;
+    StartNode->Closed = false;
+    StartNode->Queued = false;
+    StartNode->g = 0;
+    StartNode->f = (uint32_t) EstimateDistance(Start, End, Grid, Search);
+    StartNode->Parent = StartCell;
+    PushBucket(OpenList, StartCell);
+
+    while (OpenList->Size > 0) {
+        int Cell = PopBucket(OpenList);
+        bucket_node *RefNode = &Nodes[Cell];
+        RefNode->Closed = true;
+        Search->Expanded++;
+
+        if (Cell == EndCell) {
+            Search->Bound = 1.0;
+            return TraceBucketPath(Search, EndCell);
+        }
+
+        point Location = {Cell / Grid->NumberCols, Cell % Grid->NumberCols};
+        uint32_t g = RefNode->g + 1;
+        for (int m = 0; m < 4; m++) {
+            point Neighbour = {Location.Row + BucketMoves[m][0], Location.Col + BucketMoves[m][1]};
+            if (!IsWalkable(Neighbour, Grid))
+                continue;
+
+            int Next = Neighbour.Row * Grid->NumberCols + Neighbour.Col;
+            bucket_node *NextNode = &Nodes[Next];
+            if (NextNode->Stamp != Search->SearchId) {
+                NextNode->Stamp = Search->SearchId;
+                NextNode->Closed = false;
+                NextNode->Queued = false;
+                NextNode->f = g + (uint32_t) EstimateDistance(Neighbour, End, Grid, Search);
+            } else if (NextNode->Closed || NextNode->g <= g) {
+                continue;
+            } else {
+                // h stays as it was, so f drops by as much as g
+                RemoveBucket(OpenList, Next);
+                NextNode->f -= NextNode->g - g;
+            }
+
+            NextNode->g = g;
+            NextNode->Parent = Cell;
+            PushBucket(OpenList, Next);
+        }
+    }
+
     return NULL;
 }
+
+/*
+    Manhattan distance to the closest live goal: a lower bound on the 
+    distance to every one of them, so it stays consistent.
+*/
+static double NearestGoalEstimate(point Location, point *Goals, int *Live, int LiveLength) 
+{
+    int Nearest = INT_MAX;
+    for (int i = 0; i < LiveLength; i++) {
+        point Goal = Goals[Live[i]];
+        int Distance = abs(Location.Row - Goal.Row) + abs(Location.Col - Goal.Col);
+        if (Distance < Nearest)
+            Nearest = Distance;
+    }
+
+    return Nearest;
+}
+
+/*
+    One A* towards a set of goals at once, stopping at the first goal
+    taken off the open list: that is the nearest one by road, and its
+    index in Goals is written to Reached (-1 when none can be reached).
+    A goal under Start gives a path of that single cell.
+*/
+Tpath * FindPathToAny(point Start, point *Goals, int GoalsLength, astar_grid *Grid, astar_search *Search, int *Reached) 
+{
+    *Reached = -1;
+    if (Grid->IsOpenCellFunction(Start, Grid) == false)
+        return NULL;
+
+    // goals that are blocked or in another component would only widen the search
+    int *Live = (int*) malloc((GoalsLength + 1) * sizeof(int));
+    int LiveLength = 0;
+    for (int i = 0; i < GoalsLength; i++) {
+        if (Grid->IsOpenCellFunction(Goals[i], Grid) && AreConnected(Start, Goals[i], Grid))
+            Live[LiveLength++] = i;
+    }
+
+    BeginSearch(Search);
+    Theap *OpenList = &Search->OpenList;
+    Tpath *Path = NULL;
+
+    if (LiveLength > 0) {
+        search_node *StartNode = TouchNode(Start, Search);
+        StartNode->Parent = Start;
+        StartNode->g = 0.0;
+        StartNode->h = NearestGoalEstimate(Start, Goals, Live, LiveLength);
+        StartNode->f = StartNode->h;
+        PushHeap(OpenList, Start);
+    }
+
+    while (!IsHeapEmpty(OpenList)) {
+        point RefCoord = PopHeap(OpenList);
+        search_node *RefNode = GetNode(RefCoord, Search);
+        RefNode->Closed = true;
+        Search->Expanded++;
+
+        for (int i = 0; i < LiveLength && *Reached < 0; i++) {
+            if (EqualPoints(RefCoord, Goals[Live[i]]))
+                *Reached = Live[i];
+        }
+
+        if (*Reached >= 0) {
+            Path = TracePath(RefCoord, Search);
+            break;
+        }
+
+        for (int add_Row = -1; add_Row <= 1; add_Row++) {
+            for (int add_Col = -1; add_Col <= 1; add_Col++) {
+                point Neighbour = {RefCoord.Row + add_Row, RefCoord.Col + add_Col};
+                if (!IsNeighbour(RefCoord, Neighbour, Grid) || Grid->IsOpenCellFunction(Neighbour, Grid) == false)
+                    continue;
+
+                search_node *NeighbourNode = TouchNode(Neighbour, Search);
+                if (NeighbourNode->Closed)
+                    continue;
+
+                double hNew = NearestGoalEstimate(Neighbour, Goals, Live, LiveLength);
+                double fNew = RefNode->g + 1.0 + hNew;
+
+                if (NeighbourNode->f > fNew || NeighbourNode->f < 0) {
+                    NeighbourNode->f = fNew;
+                    NeighbourNode->g = RefNode->g + 1.0;
+                    NeighbourNode->h = hNew;
+                    NeighbourNode->Parent = RefCoord;
+                    DecreaseKeyHeap(OpenList, Neighbour);
+                }
+            }
+        }
+    }
+
+    free(Live);
+    return Path;
+}
+
+/*
+    Breadth-first search out of Goal that stops once the K nearest of 
+    the Sources are settled. Roads run both ways, so this reads every
+    source's route to Goal backwards. Nearest gets their indices, 
+    closest first, and Distances their road distances; returns how many
+    were found.
+*/
+int FindNearestSources(point Goal, point *Sources, int SourcesLength, int K, astar_grid *Grid, astar_search *Search, int *Nearest, int *Distances) 
+{
+    if (Grid->IsOpenCellFunction(Goal, Grid) == false)
+        return 0;
+
+    // stop early too when every source that can reach Goal is settled
+    int Reachable = 0;
+    for (int i = 0; i < SourcesLength; i++) {
+        if (Grid->IsOpenCellFunction(Sources[i], Grid) && AreConnected(Sources[i], Goal, Grid))
+            Reachable++;
+    }
+    if (Reachable < K)
+        K = Reachable;
+    if (K <= 0)
+        return 0;
+
+    BeginSearch(Search);
+    point *Queue = UseCellLists(Search);
+    int Head = 0, Tail = 0, Found = 0;
+
+    search_node *GoalNode = TouchNode(Goal, Search);
+    GoalNode->Parent = Goal;
+    GoalNode->g = 0.0;
+    GoalNode->f = 0.0;
+    Queue[Tail++] = Goal;
+
+    while (Found < K && Head < Tail) {
+        point RefCoord = Queue[Head++];
+        search_node *RefNode = GetNode(RefCoord, Search);
+        RefNode->Closed = true;
+        Search->Expanded++;
+
+        for (int i = 0; i < SourcesLength && Found < K; i++) {
+            if (EqualPoints(Sources[i], RefCoord)) {
+                Nearest[Found] = i;
+                Distances[Found] = (int) RefNode->g;
+                Found++;
+            }
+        }
+
+        for (int add_Row = -1; add_Row <= 1; add_Row++) {
+            for (int add_Col = -1; add_Col <= 1; add_Col++) {
+                point Neighbour = {RefCoord.Row + add_Row, RefCoord.Col + add_Col};
+                if (!IsNeighbour(RefCoord, Neighbour, Grid) || Grid->IsOpenCellFunction(Neighbour, Grid) == false)
+                    continue;
+
+                // the first visit of a cell is already its shortest
+                search_node *NeighbourNode = TouchNode(Neighbour, Search);
+                if (NeighbourNode->f >= 0)
+                    continue;
+
+                NeighbourNode->g = RefNode->g + 1.0;
+                NeighbourNode->f = NeighbourNode->g;
+                NeighbourNode->Parent = RefCoord;
+                Queue[Tail++] = Neighbour;
+            }
+        }
+    }
+
+    return Found;
+}
@@ -12,11 +12,18 @@ typedef struct point {
 } point;
 
 typedef struct cell {
-	double g, f, h;
 	point Location;
 	int MovementCost;
 } cell;
 
+typedef struct search_node {
+	double g, f, h;
+	point Parent;
+	int HeapIndex;
+	unsigned int Stamp;
+	bool Closed;
+} search_node;
+
 typedef struct Node {
   void *Data;
   struct Node *next;
@@ -30,33 +37,273 @@ typedef struct QueueList {
     compare_function CompareFunction;
 }Tqueue;
 
-typedef struct stack {
-	cell Data;
-	struct stack *next;
-} Tstack;
+typedef struct heap {
+	point *Nodes;
+	int Size, Capacity;
+	search_node *Scratch;
+	int NumberCols;
+} Theap;
+
+/*
+	Scratch for SEARCH_MODE_BUCKET. Every step costs one cell and both
+	heuristics are whole cells, so g and f are kept as integers; Parent
+	is a cell index and Next / Prev link the node into the bucket of
+	its f.
+*/
+typedef struct bucket_node {
+	uint32_t g, f;
+	int Parent;
+	int Next, Prev;
+	unsigned int Stamp;
+	bool Closed, Queued;
+} bucket_node;
+
+/*
+	Open list for whole-number keys (Dial): Heads[f] lists the nodes 
+	with that f, newest first. Pop moves Cursor up to the first bucket
+	that is not empty; with a consistent heuristic f never drops during
+	a search, so it never has to come back down. Top is the highest
+	bucket used since the last ClearBuckets.
+*/
+typedef struct bucket_queue {
+	int *Heads;
+	int Length;
+	int Cursor, Top;
+	int Size;
+	bucket_node *Scratch;
+} bucket_queue;
+
+typedef struct path_point {
+	int16_t Row, Col;
+} path_point;
+
+/*
+	A route is one contiguous buffer of packed coordinates, from the start
+	cell to the destination; Cursor is the next point to be followed.
+	Only the corners are stored: consecutive points share a row or a 
+	column and the route drives over every cell between them.
+*/
+typedef struct path {
+	int Length;
+	int Cursor;
+	path_point Points[];
+} Tpath;
 
 typedef bool (*is_open_cell_function)(point , void*);
 
+/* 
+    The grid only holds map data and is never written by a search, so 
+    any number of astar_search contexts can plan against it at once.
+*/
 typedef struct astar_grid {
 	int NumberRows, NumberCols;
 	cell **Map;
 	is_open_cell_function IsOpenCellFunction;
+	unsigned int Version;
+	struct landmarks *Landmarks;
+	struct hpa_graph *Hierarchy;
+	struct road_graph *Roads;
+	struct ch_graph *Contraction;
+	struct hub_labels *HubLabels;
+	struct components *Components;
+	struct passability *Passability;
 } astar_grid;
 
-Tstack * 			FindPath(point Start, point End, astar_grid *Grid);
+/*
+	Exact road distances from a few far-apart cells; the triangle
+	inequality turns them into a lower bound between any two cells.
+	Only used while Version matches the grid it was built from.
+*/
+typedef struct landmarks {
+	int Length, Capacity;
+	int CellsLength;
+	unsigned int Version;
+	point *Points;
+	int *Distances;
+} landmarks;
+
+/*
+	One bit per cell, set when the cell is open, packed 64 cells to a
+	word and WordsPerRow words per grid row. SetCellMovementCost keeps
+	it in step with the map.
+*/
+typedef struct passability {
+	int NumberRows, NumberCols;
+	int WordsPerRow;
+	unsigned int Version;
+	uint64_t *Bits;
+} passability;
+
+/*
+	Road distance from the nearest of a set of sources to every cell
+	(-1 where none is reachable). Stepping to a neighbour one closer 
+	leads to the nearest source without a search of its own.
+*/
+typedef struct distance_field {
+	int CellsLength;
+	int SourcesLength;
+	unsigned int Version;
+	int *Distances;
+} distance_field;
+
+/*
+	Connected component label of every road cell (-1 for blocked ones),
+	so unreachable goals are known before any search starts.
+*/
+typedef struct components {
+	int Length;
+	int CellsLength;
+	unsigned int Version;
+	int *Labels;
+} components;
+
+typedef enum search_mode {
+	SEARCH_MODE_ASTAR,
+	SEARCH_MODE_JPS,
+	SEARCH_MODE_BIDIRECTIONAL,
+	SEARCH_MODE_HIERARCHICAL,
+	SEARCH_MODE_ROAD_GRAPH,
+	SEARCH_MODE_CONTRACTION,
+	SEARCH_MODE_WEIGHTED,
+	SEARCH_MODE_ANYTIME,
+	SEARCH_MODE_BUCKET
+} search_mode;
+
+typedef enum heuristic_type {
+	HEURISTIC_MANHATTAN,
+	HEURISTIC_LANDMARKS
+} heuristic_type;
+
+typedef enum search_status {
+	SEARCH_IDLE,
+	SEARCH_RUNNING,
+	SEARCH_FOUND,
+	SEARCH_FAILED
+} search_status;
+
+typedef struct astar_search {
+	int NumberRows, NumberCols;
+	search_node *Nodes;
+	unsigned int SearchId;
+	Theap OpenList;
+	search_node *ReverseNodes;
+	Theap ReverseOpenList;
+	// abstract graph searches (HPA*, road graph) keep node u at GraphNodes[u]
+	search_node *GraphNodes;
+	int GraphNodesCapacity;
+	Theap GraphOpenList;
+	// HPA* keeps the cluster distances of Start and End here
+	int *GraphDistances;
+	int GraphDistancesCapacity;
+	search_mode Mode;
+	heuristic_type Heuristic;
+	int Expanded;
+
+	// SEARCH_MODE_WEIGHTED inflates h by Weight; SEARCH_MODE_ANYTIME starts
+	// there and brings it down while AnytimeBudget lasts. Bound is how
+	// many times longer than the shortest their last route can be.
+	double Weight;
+	int AnytimeBudget;
+	double Bound;
+
+	// only SEARCH_MODE_BUCKET needs the integer scratch
+	bucket_node *BucketNodes;
+	bucket_queue Buckets;
+
+	// SEARCH_MODE_ANYTIME keeps its Incons and Closed cells here,
+	// FindNearestSources its queue
+	point *CellLists;
+
+	// state of a sliced search (StartPathSearch / ContinuePathSearch)
+	point Start, End;
+	unsigned int Version;
+	search_status Status;
+	// smallest g + h a closed node would have had if it were reopened
+	double InconsLower;
+} astar_search;
+
+Tpath * 			FindPath(point Start, point End, astar_grid *Grid, astar_search *Search);
+bool 				IsPathPossible(point Start, point End, astar_grid *Grid);
+astar_search *		CreateAStarSearch(astar_grid *Grid);
+void 				DestroyAStarSearch(astar_search *Search);
+static Tpath *		FindPathAStar(point Start, point End, astar_grid *Grid, astar_search *Search);
+static void 		SeedPathSearch(point Start, point End, astar_grid *Grid, astar_search *Search);
+void 				StartPathSearch(point Start, point End, astar_grid *Grid, astar_search *Search);
+search_status 		ContinuePathSearch(astar_grid *Grid, astar_search *Search, int Budget);
+Tpath *				FinishPathSearch(astar_search *Search);
+Tpath *				FindPathToAny(point Start, point *Goals, int GoalsLength, astar_grid *Grid, astar_search *Search, int *Reached);
+int 				FindNearestSources(point Goal, point *Sources, int SourcesLength, int K, astar_grid *Grid, astar_search *Search, int *Nearest, int *Distances);
+static Tpath *		FindPathJPS(point Start, point End, astar_grid *Grid, astar_search *Search);
+static Tpath *		FindPathBidirectional(point Start, point End, astar_grid *Grid, astar_search *Search);
+static Tpath *		FindPathAnytime(point Start, point End, astar_grid *Grid, astar_search *Search);
+static Tpath *		FindPathBucket(point Start, point End, astar_grid *Grid, astar_search *Search);
+Tpath *				FindPathHierarchical(point Start, point End, astar_grid *Grid, astar_search *Search);
+Tpath *				FindPathRoadGraph(point Start, point End, astar_grid *Grid, astar_search *Search);
+Tpath *				FindPathContracted(point Start, point End, astar_grid *Grid, astar_search *Search);
 
 static cell * 		GetCell(int X, int Y, astar_grid *Grid);
+static search_node *TouchNode(point Location, astar_search *Search);
+static search_node *GetNode(point Location, astar_search *Search);
+static search_node *UseGraphNodes(astar_search *Search, int Length);
+static search_node *TouchGraphNode(int u, astar_search *Search);
+static int *		UseGraphDistances(astar_search *Search, int Length);
 static bool 		EqualPoints(point PointA, point PointB);
+static bool 		IsWalkable(point Location, astar_grid *Grid);
 static bool 		IsNeighbour(point Location, point Neighbour, astar_grid *Grid);
-double				CalculateHeuristic(point Source, point Dest, cell Node);
-Tstack* 			TracePath(point Dest, astar_grid *Grid);
-Tstack*				NewStackNode(cell Node);
-Tstack* 			PeekStack(Tstack **Stack);
-Tstack*				PopStack(Tstack **Stack);
-void				PushStack(Tstack **Stack, cell Node);
-int 				IsStackEmpty(Tstack *Stack);
-void 				PrintStack(Tstack *Stack);
-void                DestroyStack(Tstack **Stack);
+double				CalculateHeuristic(point Source, point Dest, search_node Node);
+double 				LandmarkDistance(point From, point To, astar_grid *Grid);
+double 				EstimateDistance(point From, point To, astar_grid *Grid, astar_search *Search);
+void 				SetCellMovementCost(astar_grid *Grid, point Location, int MovementCost);
+void 				BreadthFirstDistances(astar_grid *Grid, point Source, int *Distances, int *Queue);
+passability *		CreatePassability(astar_grid *Grid);
+void 				BuildPassability(passability *Passability, astar_grid *Grid);
+void 				SetPassable(passability *Passability, point Location, bool Passable);
+void 				DestroyPassability(passability *Passability);
+void 				BitParallelDistances(astar_grid *Grid, point *Sources, int SourcesLength, int *Distances);
+
+distance_field *	CreateDistanceField(astar_grid *Grid);
+void 				BuildDistanceField(distance_field *Field, astar_grid *Grid, point *Sources, int SourcesLength);
+int 				FieldDistance(distance_field *Field, astar_grid *Grid, point Location);
+point 				NextFieldStep(distance_field *Field, astar_grid *Grid, point From);
+void 				DestroyDistanceField(distance_field *Field);
+components *		CreateComponents(astar_grid *Grid);
+void 				BuildComponents(components *Components, astar_grid *Grid);
+bool 				AreConnected(point A, point B, astar_grid *Grid);
+void 				DestroyComponents(components *Components);
+landmarks *			CreateLandmarks(astar_grid *Grid, int Length);
+void 				BuildLandmarks(landmarks *Landmarks, astar_grid *Grid);
+void 				DestroyLandmarks(landmarks *Landmarks);
+Tpath* 				TracePath(point Dest, astar_search *Search);
+Tpath*				NewPath(int Length);
+Tpath*				CopyPath(Tpath *Path);
+point 				GetPathPoint(Tpath *Path, int i);
+point 				PeekPath(Tpath *Path);
+point				PopPath(Tpath *Path);
+int 				PathLength(Tpath *Path);
+int 				PathDistance(Tpath *Path);
+int 				IsPathEmpty(Tpath *Path);
+bool 				IsOnSegment(point From, point To, point Location);
+bool 				PathContains(Tpath *Path, point Location);
+Tpath*				CompressPath(Tpath *Path);
+void 				AppendPath(Tpath **Path, Tpath *Tail);
+void 				PrintPath(Tpath *Path);
+void                DestroyPath(Tpath **Path);
+
+void 				InitHeap(Theap *Heap, int Capacity, search_node *Scratch, int NumberCols);
+void 				PushHeap(Theap *Heap, point Location);
+point				PopHeap(Theap *Heap);
+void 				DecreaseKeyHeap(Theap *Heap, point Location);
+void 				UpdateKeyHeap(Theap *Heap, point Location);
+void 				RemoveHeap(Theap *Heap, point Location);
+int 				IsHeapEmpty(Theap *Heap);
+void 				DestroyHeap(Theap *Heap);
+
+void 				InitBucketQueue(bucket_queue *Queue, int Length, bucket_node *Scratch);
+void 				ClearBuckets(bucket_queue *Queue);
+void 				PushBucket(bucket_queue *Queue, int Node);
+int 				PopBucket(bucket_queue *Queue);
+void 				RemoveBucket(bucket_queue *Queue, int Node);
+void 				DestroyBucketQueue(bucket_queue *Queue);
 
 void 	 			InitQueue(Tqueue *Queue, size_t allocSize, compare_function Function);
 void 				PeekQueue(Tqueue *Queue, void *data);
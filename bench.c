@@ -0,0 +1,148 @@
+/*
+	Times the search modes on the game's city map without opening a
+	window: `make bench`. Builds only the search modules, so it needs
+	no SDL.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <limits.h>
+#include <time.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "aStar.c"
+#include "hpa.c"
+#include "roadGraph.c"
+#include "contraction.c"
+#include "hubLabels.c"
+
+#define BENCH_ROWS 45
+#define BENCH_COLS 80
+#define BENCH_PAIRS 500
+// on a map with few connected open cells, give up instead of drawing forever
+#define MAX_PAIR_ATTEMPTS 100000
+
+bool IsOpenCellFunction(point Location, void *AStarGrid)
+{
+	return ((astar_grid*) AStarGrid)->Map[Location.Row][Location.Col].MovementCost == 1;
+}
+
+/* The same layout CreateAStarGrid gives the game: blocks with half the road cells closed. */
+astar_grid * CreateBenchGrid()
+{
+	astar_grid *Grid = (astar_grid*) malloc(sizeof(astar_grid));
+	Grid->NumberRows = BENCH_ROWS;
+	Grid->NumberCols = BENCH_COLS;
+	Grid->IsOpenCellFunction = IsOpenCellFunction;
+	Grid->Version = 0;
+	Grid->Map = (cell**) malloc(Grid->NumberRows * sizeof(cell*));
+	for (int i = 0; i < Grid->NumberRows; i++) {
+		Grid->Map[i] = (cell*) calloc(Grid->NumberCols, sizeof(cell));
+		for (int j = 0; j < Grid->NumberCols; j++) {
+			Grid->Map[i][j].MovementCost = (i % 10 == 2 || j % 10 == 2) ? rand() % 2 : 1;
+			Grid->Map[i][j].Location = (point) {i, j};
+		}
+	}
+
+	Grid->Passability = CreatePassability(Grid);
+	Grid->Components = CreateComponents(Grid);
+	Grid->Landmarks = CreateLandmarks(Grid, 8);
+	Grid->Hierarchy = CreateHierarchy(Grid, 10);
+	Grid->Roads = CreateRoadGraph(Grid);
+	Grid->Contraction = CreateContraction(Grid);
+	Grid->HubLabels = NULL;
+
+	return Grid;
+}
+
+void DestroyBenchGrid(astar_grid *Grid)
+{
+	for (int i = 0; i < Grid->NumberRows; i++) {
+		free(Grid->Map[i]);
+	}
+
+	DestroyLandmarks(Grid->Landmarks);
+	DestroyHierarchy(Grid->Hierarchy);
+	DestroyRoadGraph(Grid->Roads);
+	DestroyContraction(Grid->Contraction);
+	DestroyComponents(Grid->Components);
+	DestroyPassability(Grid->Passability);
+	free(Grid->Map);
+	free(Grid);
+}
+
+/* Draws up to PairsLength connected pairs; returns how many it found. */
+int PickBenchPairs(astar_grid *Grid, point *Pairs, int PairsLength)
+{
+	int Found = 0;
+	for (int Attempt = 0; Found < PairsLength && Attempt < MAX_PAIR_ATTEMPTS; Attempt++) {
+		point From = {rand() % Grid->NumberRows, rand() % Grid->NumberCols};
+		point To = {rand() % Grid->NumberRows, rand() % Grid->NumberCols};
+		if (!IsWalkable(From, Grid) || !IsWalkable(To, Grid) || !AreConnected(From, To, Grid))
+			continue;
+
+		Pairs[2 * Found] = From;
+		Pairs[2 * Found + 1] = To;
+		Found++;
+	}
+
+	return Found;
+}
+
+static const char *ModeNames[] = {"astar", "jps", "bidirectional", "hierarchical", "road graph", "contraction", "weighted", "anytime", "bucket"};
+
+int main(int argc, char *args[])
+{
+	srand(argc > 1 ? atoi(args[1]) : 1);
+	astar_grid *Grid = CreateBenchGrid();
+	astar_search *Search = CreateAStarSearch(Grid);
+	point *Pairs = (point*) malloc(2 * BENCH_PAIRS * sizeof(point));
+	int *Distances = (int*) malloc(BENCH_PAIRS * sizeof(int));
+
+	int PairsLength = PickBenchPairs(Grid, Pairs, BENCH_PAIRS);
+	printf("%dx%d map, %d road nodes, %d routes\n", Grid->NumberRows, Grid->NumberCols, Grid->Roads->NodesLength, PairsLength);
+	if (PairsLength == 0) {
+		printf("No connected pairs on this map\n");
+		return 1;
+	}
+
+	Search->Weight = 1.5;
+	for (int Heuristic = HEURISTIC_MANHATTAN; Heuristic <= HEURISTIC_LANDMARKS; Heuristic++) {
+		Search->Heuristic = (heuristic_type) Heuristic;
+		printf("\n%s heuristic\n", Heuristic == HEURISTIC_MANHATTAN ? "manhattan" : "landmark");
+
+		for (int Mode = SEARCH_MODE_ASTAR; Mode <= SEARCH_MODE_BUCKET; Mode++) {
+			Search->Mode = (search_mode) Mode;
+			long Expanded = 0;
+			int Longer = 0;
+
+			clock_t Begin = clock();
+			for (int i = 0; i < PairsLength; i++) {
+				Tpath *Path = FindPath(Pairs[2 * i], Pairs[2 * i + 1], Grid, Search);
+				Expanded += Search->Expanded;
+				// A* is the first mode, so its lengths are the reference
+				if (Mode == SEARCH_MODE_ASTAR)
+					Distances[i] = PathDistance(Path);
+				else if (PathDistance(Path) > Distances[i])
+					Longer++;
+				DestroyPath(&Path);
+			}
+			double Seconds = (double) (clock() - Begin) / CLOCKS_PER_SEC;
+
+			printf("  %-14s %8.1f us per route %8ld expansions %4d longer than A*\n",
+				   ModeNames[Mode], 1e6 * Seconds / PairsLength, Expanded / PairsLength, Longer);
+		}
+	}
+
+	free(Distances);
+	free(Pairs);
+	DestroyAStarSearch(Search);
+	DestroyBenchGrid(Grid);
+
+	return 0;
+}
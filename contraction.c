@@ -0,0 +1,494 @@
+#include "contraction.h"
+
+#define CH_WITNESS_SETTLED_LIMIT 128
+
+typedef struct ch_edges {
+    ch_edge *Edges;
+    int Length, Capacity;
+} ch_edges;
+
+/*
+    Scratch of a build: what is left of the graph, the upward edges
+    collected so far, and two one-column search node arrays, one that
+    orders the nodes by priority and one for the witness searches.
+*/
+typedef struct ch_builder {
+    int NodesLength;
+    ch_edges *Adjacent;
+    ch_edges *Up;
+    bool *Contracted;
+    int *Deleted;
+
+    search_node *Priorities;
+    Theap Queue;
+    search_node *Witness;
+    Theap WitnessList;
+    unsigned int WitnessId;
+} ch_builder;
+
+static void AddContractionEdge(ch_edges *List, int To, int Cost, int Middle)
+{
+    for (int i = 0; i < List->Length; i++) {
+        if (List->Edges[i].To == To) {
+            if (Cost < List->Edges[i].Cost)
+                List->Edges[i] = (ch_edge) {To, Cost, Middle};
+            return;
+        }
+    }
+
+    if (List->Length >= List->Capacity) {
+        List->Capacity = List->Capacity > 0 ? List->Capacity * 2 : 4;
+        List->Edges = (ch_edge*) realloc(List->Edges, List->Capacity * sizeof(ch_edge));
+    }
+
+    List->Edges[List->Length++] = (ch_edge) {To, Cost, Middle};
+}
+
+/*
+    Dijkstra from Source over the nodes not contracted yet, leaving out
+    Skip, until it passes Limit or has settled enough nodes. Distances
+    it did not get to are taken as infinite, which at worst adds a
+    shortcut that was not needed.
+*/
+static void WitnessSearch(ch_builder *Builder, int Source, int Skip, int Limit)
+{
+    Builder->WitnessId++;
+    Builder->WitnessList.Size = 0;
+
+    search_node *Node = RefreshNode(&Builder->Witness[Source], Builder->WitnessId);
+    Node->g = 0;
+    Node->f = 0;
+    PushHeap(&Builder->WitnessList, (point) {Source, 0});
+
+    int Settled = 0;
+    while (!IsHeapEmpty(&Builder->WitnessList) && Settled < CH_WITNESS_SETTLED_LIMIT) {
+        int u = PopHeap(&Builder->WitnessList).Row;
+        Node = &Builder->Witness[u];
+        Node->Closed = true;
+        Settled++;
+
+        if (Node->g > Limit)
+            break;
+
+        ch_edges *Edges = &Builder->Adjacent[u];
+        for (int k = 0; k < Edges->Length; k++) {
+            ch_edge Edge = Edges->Edges[k];
+            if (Edge.To == Skip || Builder->Contracted[Edge.To])
+                continue;
+
+            search_node *Next = RefreshNode(&Builder->Witness[Edge.To], Builder->WitnessId);
+            if (Next->Closed)
+                continue;
+
+            double gNew = Node->g + Edge.Cost;
+            if (Next->f < 0 || gNew < Next->g) {
+                Next->g = gNew;
+                Next->f = gNew;
+                DecreaseKeyHeap(&Builder->WitnessList, (point) {Edge.To, 0});
+            }
+        }
+    }
+}
+
+static double WitnessDistance(ch_builder *Builder, int u)
+{
+    search_node *Node = &Builder->Witness[u];
+    if (Node->Stamp != Builder->WitnessId || Node->f < 0)
+        return INT_MAX;
+    return Node->g;
+}
+
+/*
+    Counts the shortcuts contracting v needs, and adds them when Apply
+    is set: one between two of its neighbours whenever no route around
+    v is as short as the one through it.
+*/
+static int ContractNode(ch_builder *Builder, int v, bool Apply)
+{
+    ch_edges *Edges = &Builder->Adjacent[v];
+    int Shortcuts = 0;
+    int MaxCost = 0;
+
+    for (int i = 0; i < Edges->Length; i++) {
+        if (!Builder->Contracted[Edges->Edges[i].To] && Edges->Edges[i].Cost > MaxCost)
+            MaxCost = Edges->Edges[i].Cost;
+    }
+
+    for (int i = 0; i < Edges->Length; i++) {
+        ch_edge In = Edges->Edges[i];
+        if (Builder->Contracted[In.To])
+            continue;
+
+        WitnessSearch(Builder, In.To, v, In.Cost + MaxCost);
+        for (int j = i + 1; j < Edges->Length; j++) {
+            ch_edge Out = Edges->Edges[j];
+            int Cost = In.Cost + Out.Cost;
+            if (Builder->Contracted[Out.To] || WitnessDistance(Builder, Out.To) <= Cost)
+                continue;
+
+            Shortcuts++;
+            if (Apply) {
+                AddContractionEdge(&Builder->Adjacent[In.To], Out.To, Cost, v);
+                AddContractionEdge(&Builder->Adjacent[Out.To], In.To, Cost, v);
+            }
+        }
+    }
+
+    return Shortcuts;
+}
+
+/*
+    Edge difference: shortcuts added minus edges removed, plus the
+    neighbours already contracted so the order spreads over the map.
+*/
+static double ContractionPriority(ch_builder *Builder, int v)
+{
+    int Degree = 0;
+    for (int i = 0; i < Builder->Adjacent[v].Length; i++) {
+        if (!Builder->Contracted[Builder->Adjacent[v].Edges[i].To])
+            Degree++;
+    }
+
+    return ContractNode(Builder, v, false) - Degree + Builder->Deleted[v];
+}
+
+ch_graph * CreateContraction(astar_grid *Grid)
+{
+    ch_graph *Contraction = (ch_graph*) malloc(sizeof(ch_graph));
+    Contraction->NodesLength = 0;
+    Contraction->Rank = NULL;
+    Contraction->UpStart = NULL;
+    Contraction->Up = NULL;
+    Contraction->UpLength = 0;
+    Contraction->ShortcutsLength = 0;
+    BuildContraction(Contraction, Grid);
+
+    return Contraction;
+}
+
+/*
+    Contracts the nodes of Grid->Roads, which has to be up to date,
+    lazily re-checking the priority of the next node before it goes.
+*/
+void BuildContraction(ch_graph *Contraction, astar_grid *Grid)
+{
+    road_graph *Roads = Grid->Roads;
+    int Length = Roads->NodesLength;
+
+    ch_builder Builder;
+    Builder.NodesLength = Length;
+    Builder.Adjacent = (ch_edges*) calloc(Length, sizeof(ch_edges));
+    Builder.Up = (ch_edges*) calloc(Length, sizeof(ch_edges));
+    Builder.Contracted = (bool*) calloc(Length, sizeof(bool));
+    Builder.Deleted = (int*) calloc(Length, sizeof(int));
+    Builder.Priorities = (search_node*) calloc(Length, sizeof(search_node));
+    Builder.Witness = (search_node*) calloc(Length, sizeof(search_node));
+    Builder.WitnessId = 0;
+    InitHeap(&Builder.Queue, 64, Builder.Priorities, 1);
+    InitHeap(&Builder.WitnessList, 64, Builder.Witness, 1);
+
+    for (int u = 0; u < Length; u++) {
+        for (int k = 0; k < Roads->Nodes[u].EdgesLength; k++) {
+            road_edge Edge = Roads->Nodes[u].Edges[k];
+            AddContractionEdge(&Builder.Adjacent[u], Edge.To, Edge.Cost, -1);
+        }
+    }
+
+    for (int v = 0; v < Length; v++) {
+        Builder.Priorities[v].f = ContractionPriority(&Builder, v);
+        Builder.Priorities[v].HeapIndex = -1;
+        PushHeap(&Builder.Queue, (point) {v, 0});
+    }
+
+    Contraction->Rank = (int*) realloc(Contraction->Rank, Length * sizeof(int));
+    Contraction->ShortcutsLength = 0;
+
+    int Rank = 0;
+    while (!IsHeapEmpty(&Builder.Queue)) {
+        int v = PopHeap(&Builder.Queue).Row;
+        double Priority = ContractionPriority(&Builder, v);
+        if (!IsHeapEmpty(&Builder.Queue) && Priority > Builder.Priorities[Builder.Queue.Nodes[0].Row].f) {
+            Builder.Priorities[v].f = Priority;
+            PushHeap(&Builder.Queue, (point) {v, 0});
+            continue;
+        }
+
+        // whatever v still links to is contracted later, so those edges go up
+        ch_edges *Edges = &Builder.Adjacent[v];
+        for (int i = 0; i < Edges->Length; i++) {
+            if (!Builder.Contracted[Edges->Edges[i].To])
+                AddContractionEdge(&Builder.Up[v], Edges->Edges[i].To, Edges->Edges[i].Cost, Edges->Edges[i].Middle);
+        }
+
+        Contraction->ShortcutsLength += ContractNode(&Builder, v, true);
+        Builder.Contracted[v] = true;
+        Contraction->Rank[v] = Rank++;
+
+        for (int i = 0; i < Edges->Length; i++) {
+            if (!Builder.Contracted[Edges->Edges[i].To])
+                Builder.Deleted[Edges->Edges[i].To]++;
+        }
+    }
+
+    Contraction->NodesLength = Length;
+    Contraction->UpStart = (int*) realloc(Contraction->UpStart, (Length + 1) * sizeof(int));
+    Contraction->UpLength = 0;
+    for (int u = 0; u < Length; u++) {
+        Contraction->UpStart[u] = Contraction->UpLength;
+        Contraction->UpLength += Builder.Up[u].Length;
+    }
+    Contraction->UpStart[Length] = Contraction->UpLength;
+
+    Contraction->Up = (ch_edge*) realloc(Contraction->Up, (Contraction->UpLength + 1) * sizeof(ch_edge));
+    for (int u = 0; u < Length; u++) {
+        if (Builder.Up[u].Length > 0)
+            memcpy(&Contraction->Up[Contraction->UpStart[u]], Builder.Up[u].Edges, Builder.Up[u].Length * sizeof(ch_edge));
+        free(Builder.Up[u].Edges);
+        free(Builder.Adjacent[u].Edges);
+    }
+
+    DestroyHeap(&Builder.Queue);
+    DestroyHeap(&Builder.WitnessList);
+    free(Builder.Adjacent);
+    free(Builder.Up);
+    free(Builder.Contracted);
+    free(Builder.Deleted);
+    free(Builder.Priorities);
+    free(Builder.Witness);
+
+    Contraction->Version = Roads->Version;
+}
+
+void DestroyContraction(ch_graph *Contraction)
+{
+    free(Contraction->Rank);
+    free(Contraction->UpStart);
+    free(Contraction->Up);
+    free(Contraction);
+}
+
+static bool IsContractionCurrent(astar_grid *Grid)
+{
+    return Grid->Roads != NULL && Grid->Roads->Version == Grid->Version
+        && Grid->Contraction != NULL && Grid->Contraction->Version == Grid->Version;
+}
+
+/*
+    Node u of the road graph lives in the search scratch at the cell
+    with the same index.
+*/
+static point ContractedPoint(astar_search *Search, int u)
+{
+    return (point) {u / Search->NumberCols, u % Search->NumberCols};
+}
+
+static int ContractedIndex(astar_search *Search, point Location)
+{
+    return Location.Row * Search->NumberCols + Location.Col;
+}
+
+static void SeedContractedQuery(Theap *OpenList, search_node *Node, point Location, int Cost)
+{
+    if (Node->f >= 0 && Node->g <= Cost)
+        return;
+
+    Node->g = Cost;
+    Node->f = Cost;
+    Node->Parent = Location;
+    DecreaseKeyHeap(OpenList, Location);
+}
+
+/*
+    Upward Dijkstra from both ends at once, each seeded with the nodes
+    at the ends of its corridor. Returns the length of the shortest
+    route (-1 when there is none) and the node the halves met at in
+    *Meet, -1 when the direct drive along a shared corridor wins.
+*/
+static int RunContractedQuery(point Start, point End, astar_grid *Grid, astar_search *Search, int *Meet)
+{
+    road_graph *Roads = Grid->Roads;
+    ch_graph *Contraction = Grid->Contraction;
+    road_edge StartAnchors[4], EndAnchors[4];
+    int Best = -1, Unused = -1;
+    int StartAnchorsLength = AnchorRoadCell(Roads, Grid, Start, End, StartAnchors, &Best);
+    int EndAnchorsLength = AnchorRoadCell(Roads, Grid, End, Start, EndAnchors, &Unused);
+    *Meet = -1;
+
+    UseReverseNodes(Search);
+    BeginSearch(Search);
+
+    for (int k = 0; k < StartAnchorsLength; k++) {
+        point Location = ContractedPoint(Search, StartAnchors[k].To);
+        SeedContractedQuery(&Search->OpenList, TouchNode(Location, Search), Location, StartAnchors[k].Cost);
+    }
+    for (int k = 0; k < EndAnchorsLength; k++) {
+        point Location = ContractedPoint(Search, EndAnchors[k].To);
+        SeedContractedQuery(&Search->ReverseOpenList, TouchReverseNode(Location, Search), Location, EndAnchors[k].Cost);
+    }
+
+    while (!IsHeapEmpty(&Search->OpenList) || !IsHeapEmpty(&Search->ReverseOpenList)) {
+        double ForwardKey = IsHeapEmpty(&Search->OpenList) ? INT_MAX : GetNode(Search->OpenList.Nodes[0], Search)->f;
+        double BackwardKey = IsHeapEmpty(&Search->ReverseOpenList) ? INT_MAX : TouchReverseNode(Search->ReverseOpenList.Nodes[0], Search)->f;
+        bool Forward = ForwardKey <= BackwardKey;
+        if (Best >= 0 && (Forward ? ForwardKey : BackwardKey) >= Best)
+            break;
+
+        Theap *OpenList = Forward ? &Search->OpenList : &Search->ReverseOpenList;
+        point RefCoord = PopHeap(OpenList);
+        search_node *RefNode = Forward ? GetNode(RefCoord, Search) : TouchReverseNode(RefCoord, Search);
+        RefNode->Closed = true;
+        Search->Expanded++;
+
+        search_node *Other = Forward ? TouchReverseNode(RefCoord, Search) : TouchNode(RefCoord, Search);
+        if (Other->f >= 0 && (Best < 0 || RefNode->g + Other->g < Best)) {
+            Best = RefNode->g + Other->g;
+            *Meet = ContractedIndex(Search, RefCoord);
+        }
+
+        int u = ContractedIndex(Search, RefCoord);
+        for (int k = Contraction->UpStart[u]; k < Contraction->UpStart[u + 1]; k++) {
+            ch_edge Edge = Contraction->Up[k];
+            point Neighbour = ContractedPoint(Search, Edge.To);
+            search_node *NeighbourNode = Forward ? TouchNode(Neighbour, Search) : TouchReverseNode(Neighbour, Search);
+            if (NeighbourNode->Closed)
+                continue;
+
+            double gNew = RefNode->g + Edge.Cost;
+            if (NeighbourNode->f < 0 || gNew < NeighbourNode->g) {
+                NeighbourNode->g = gNew;
+                NeighbourNode->f = gNew;
+                NeighbourNode->Parent = RefCoord;
+                DecreaseKeyHeap(OpenList, Neighbour);
+            }
+        }
+    }
+
+    return Best;
+}
+
+static void PushRouteWaypoint(Tpath **Route, int *Capacity, point Location)
+{
+    Tpath *Waypoints = *Route;
+    if (Waypoints->Length > 0 && EqualPoints(GetPathPoint(Waypoints, Waypoints->Length - 1), Location))
+        return;
+
+    if (Waypoints->Length >= *Capacity) {
+        *Capacity *= 2;
+        Waypoints = (Tpath*) realloc(Waypoints, sizeof(Tpath) + *Capacity * sizeof(path_point));
+        *Route = Waypoints;
+    }
+
+    Waypoints->Points[Waypoints->Length++] = (path_point) {Location.Row, Location.Col};
+}
+
+/*
+    Writes the road nodes a (shortcut) edge from a to b stands for,
+    leaving out a itself. The edge is kept by whichever of the two was
+    contracted first, and its Middle was contracted before both.
+*/
+static void UnpackContractedEdge(road_graph *Roads, ch_graph *Contraction, int a, int b, Tpath **Route, int *Capacity)
+{
+    int Lower = Contraction->Rank[a] < Contraction->Rank[b] ? a : b;
+    int Upper = Lower == a ? b : a;
+    int Middle = -1;
+
+    for (int k = Contraction->UpStart[Lower]; k < Contraction->UpStart[Lower + 1]; k++) {
+        if (Contraction->Up[k].To == Upper) {
+            Middle = Contraction->Up[k].Middle;
+            break;
+        }
+    }
+
+    if (Middle < 0) {
+        PushRouteWaypoint(Route, Capacity, Roads->Nodes[b].Location);
+        return;
+    }
+
+    UnpackContractedEdge(Roads, Contraction, a, Middle, Route, Capacity);
+    UnpackContractedEdge(Roads, Contraction, Middle, b, Route, Capacity);
+}
+
+/*
+    Same waypoints as FindRoadRoute (Start, road nodes..., End), found
+    with a contraction hierarchy query and unpacked from its shortcuts.
+    NULL when End cannot be reached or the hierarchy is out of date.
+*/
+Tpath * FindContractedRoute(point Start, point End, astar_grid *Grid, astar_search *Search)
+{
+    if (!IsContractionCurrent(Grid) || !AreConnected(Start, End, Grid) || EqualPoints(Start, End))
+        return NULL;
+
+    road_graph *Roads = Grid->Roads;
+    ch_graph *Contraction = Grid->Contraction;
+    int Meet;
+    if (RunContractedQuery(Start, End, Grid, Search, &Meet) < 0)
+        return NULL;
+
+    int Capacity = 16;
+    Tpath *Route = NewPath(Capacity);
+    Route->Length = 0;
+    PushRouteWaypoint(&Route, &Capacity, Start);
+
+    if (Meet >= 0) {
+        // the forward half is linked from Meet back to its root
+        int ChainLength = 0;
+        int *Chain = (int*) malloc(Roads->NodesLength * sizeof(int));
+        for (point Current = ContractedPoint(Search, Meet); ; Current = GetNode(Current, Search)->Parent) {
+            Chain[ChainLength++] = ContractedIndex(Search, Current);
+            if (EqualPoints(GetNode(Current, Search)->Parent, Current))
+                break;
+        }
+
+        PushRouteWaypoint(&Route, &Capacity, Roads->Nodes[Chain[ChainLength - 1]].Location);
+        for (int i = ChainLength - 1; i > 0; i--) {
+            UnpackContractedEdge(Roads, Contraction, Chain[i], Chain[i - 1], &Route, &Capacity);
+        }
+        free(Chain);
+
+        point Current = ContractedPoint(Search, Meet);
+        search_node *Node = TouchReverseNode(Current, Search);
+        while (!EqualPoints(Node->Parent, Current)) {
+            UnpackContractedEdge(Roads, Contraction, ContractedIndex(Search, Current), ContractedIndex(Search, Node->Parent), &Route, &Capacity);
+            Current = Node->Parent;
+            Node = TouchReverseNode(Current, Search);
+        }
+    }
+
+    PushRouteWaypoint(&Route, &Capacity, End);
+    return Route;
+}
+
+/*
+    Length of the shortest route from Start to End in cells, or -1 when
+    there is none. Plans the route the slow way while the hierarchy
+    waits for RefreshAStarGrid to rebuild it.
+*/
+int ContractedDistance(point Start, point End, astar_grid *Grid, astar_search *Search)
+{
+    if (EqualPoints(Start, End) && IsWalkable(Start, Grid))
+        return 0;
+    if (!AreConnected(Start, End, Grid))
+        return -1;
+
+    if (!IsContractionCurrent(Grid)) {
+        Tpath *Path = FindPathRoadGraph(Start, End, Grid, Search);
+        int Distance = Path != NULL ? PathDistance(Path) : -1;
+        DestroyPath(&Path);
+        return Distance;
+    }
+
+    int Meet;
+    return RunContractedQuery(Start, End, Grid, Search, &Meet);
+}
+
+Tpath * FindPathContracted(point Start, point End, astar_grid *Grid, astar_search *Search)
+{
+    if (!IsContractionCurrent(Grid))
+        return FindPathRoadGraph(Start, End, Grid, Search);
+
+    Tpath *Route = FindContractedRoute(Start, End, Grid, Search);
+    Tpath *Path = ExpandRoadRoute(Route, Grid);
+    DestroyPath(&Route);
+
+    return Path;
+}
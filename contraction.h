@@ -0,0 +1,28 @@
+typedef struct ch_edge {
+	int To;
+	int Cost;
+	int Middle;
+} ch_edge;
+
+/*
+	Contraction hierarchy over the road graph. Nodes are contracted one
+	at a time, least important first, and a shortcut (with the contracted
+	node as its Middle) replaces every shortest route through it. Only
+	the edges leading to a node contracted later are kept, UpStart[u] to
+	UpStart[u + 1] in Up, so both halves of a query only ever climb.
+*/
+typedef struct ch_graph {
+	unsigned int Version;
+	int NodesLength;
+	int *Rank;
+	int *UpStart;
+	ch_edge *Up;
+	int UpLength;
+	int ShortcutsLength;
+} ch_graph;
+
+ch_graph *			CreateContraction(astar_grid *Grid);
+void 				BuildContraction(ch_graph *Contraction, astar_grid *Grid);
+void 				DestroyContraction(ch_graph *Contraction);
+int 				ContractedDistance(point Start, point End, astar_grid *Grid, astar_search *Search);
+Tpath *				FindContractedRoute(point Start, point End, astar_grid *Grid, astar_search *Search);
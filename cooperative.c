@@ -0,0 +1,229 @@
+#include "cooperative.h"
+
+// waiting in place comes first, so a tie between waiting and a detour goes to waiting
+static const int CooperativeMoves[5][2] = {{0, 0}, {-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+static int ReservationSlot(reservation_table *Table, point Location, unsigned int Tick)
+{
+    return (Tick % Table->Horizon) * Table->CellsLength + Location.Row * Table->NumberCols + Location.Col;
+}
+
+static bool IsInWindow(reservation_table *Table, unsigned int Tick)
+{
+    return Tick >= Table->Now && Tick < Table->Now + Table->Horizon;
+}
+
+reservation_table * CreateReservationTable(astar_grid *Grid, int Horizon)
+{
+    reservation_table *Table = (reservation_table*) malloc(sizeof(reservation_table));
+    Table->Horizon = Horizon;
+    Table->CellsLength = Grid->NumberRows * Grid->NumberCols;
+    Table->NumberCols = Grid->NumberCols;
+    // tick 0 is never live, so the zeroed slots start out free
+    Table->Now = 1;
+    Table->Owner = (int*) malloc(Horizon * Table->CellsLength * sizeof(int));
+    Table->Tick = (unsigned int*) calloc(Horizon * Table->CellsLength, sizeof(unsigned int));
+
+    return Table;
+}
+
+void AdvanceReservations(reservation_table *Table)
+{
+    Table->Now++;
+}
+
+/*
+    Taxi holding Location at Tick, or -1 when the cell is free then.
+    Nothing is known about ticks outside the window, so they are free.
+*/
+int ReservationOwner(reservation_table *Table, point Location, unsigned int Tick)
+{
+    if (!IsInWindow(Table, Tick))
+        return -1;
+
+    int Slot = ReservationSlot(Table, Location, Tick);
+    return Table->Tick[Slot] == Tick ? Table->Owner[Slot] : -1;
+}
+
+/*
+    Steps holds one cell per tick from FromTick on; the ones that fall
+    inside the window are claimed for Agent. The last cell stays held
+    to the end of the window: a taxi parked there must not be boxed in
+    by routes planned through it before it plans its next window.
+*/
+void ReserveSteps(reservation_table *Table, Tpath *Steps, unsigned int FromTick, int Agent)
+{
+    for (unsigned int Tick = Table->Now; Tick < Table->Now + Table->Horizon; Tick++) {
+        if (Tick < FromTick)
+            continue;
+
+        int i = Tick - FromTick < Steps->Length ? Tick - FromTick : Steps->Length - 1;
+        int Slot = ReservationSlot(Table, GetPathPoint(Steps, i), Tick);
+        if (i == Steps->Length - 1 && Table->Tick[Slot] == Tick && Table->Owner[Slot] != Agent)
+            break;
+
+        Table->Owner[Slot] = Agent;
+        Table->Tick[Slot] = Tick;
+    }
+}
+
+void ReleaseSteps(reservation_table *Table, Tpath *Steps, unsigned int FromTick, int Agent)
+{
+    if (Steps == NULL)
+        return;
+
+    for (unsigned int Tick = Table->Now; Tick < Table->Now + Table->Horizon; Tick++) {
+        if (Tick < FromTick)
+            continue;
+
+        int i = Tick - FromTick < Steps->Length ? Tick - FromTick : Steps->Length - 1;
+        if (ReservationOwner(Table, GetPathPoint(Steps, i), Tick) == Agent)
+            Table->Tick[ReservationSlot(Table, GetPathPoint(Steps, i), Tick)] = 0;
+    }
+}
+
+void DestroyReservationTable(reservation_table *Table)
+{
+    if (Table == NULL)
+        return;
+
+    free(Table->Owner);
+    free(Table->Tick);
+    free(Table);
+}
+
+cooperative_search * CreateCooperativeSearch(astar_grid *Grid, int Horizon)
+{
+    cooperative_search *Search = (cooperative_search*) malloc(sizeof(cooperative_search));
+    Search->Horizon = Horizon;
+    Search->CellsLength = Grid->NumberRows * Grid->NumberCols;
+    Search->NumberCols = Grid->NumberCols;
+    Search->Nodes = (search_node*) calloc(Horizon * Search->CellsLength, sizeof(search_node));
+    Search->SearchId = 0;
+    InitHeap(&Search->OpenList, 64, Search->Nodes, 1);
+    Search->Expanded = 0;
+
+    return Search;
+}
+
+static void BeginCooperativeSearch(cooperative_search *Search)
+{
+    Search->SearchId++;
+    if (Search->SearchId == 0) {
+        for (int i = 0; i < Search->Horizon * Search->CellsLength; i++) {
+            Search->Nodes[i].Stamp = 0;
+        }
+        Search->SearchId = 1;
+    }
+
+    Search->OpenList.Size = 0;
+    Search->Expanded = 0;
+}
+
+static double CooperativeEstimate(point From, point Goal, astar_grid *Grid)
+{
+    return fmax(abs(From.Row - Goal.Row) + abs(From.Col - Goal.Col), LandmarkDistance(From, Goal, Grid));
+}
+
+/*
+    Moving into a cell is only allowed when no other taxi holds it on
+    the next tick, and not when the taxi in it is coming the other way:
+    two taxis swapping cells would drive through each other.
+*/
+static bool IsStepFree(reservation_table *Table, point From, point To, unsigned int Tick, int Agent)
+{
+    int Owner = ReservationOwner(Table, To, Tick + 1);
+    if (Owner >= 0 && Owner != Agent)
+        return false;
+
+    int Oncoming = ReservationOwner(Table, From, Tick + 1);
+    return Oncoming < 0 || Oncoming == Agent || ReservationOwner(Table, To, Tick) != Oncoming;
+}
+
+/*
+    Route from Start at Table->Now that keeps clear of what the other
+    taxis reserved, one point per tick (a repeated point is a tick spent
+    waiting), so it is not compressed to corners. The search stops at
+    Goal or at the edge of the window, whichever comes first; past the
+    window the other taxis are not known yet and the caller plans the
+    next window before this one runs out. When other taxis box Start in
+    for part of the window the route only covers the ticks that are 
+    clear. NULL when Goal cannot be reached.
+*/
+Tpath * FindPathCooperative(point Start, point Goal, int Agent, reservation_table *Table, astar_grid *Grid, cooperative_search *Search)
+{
+    if (!IsWalkable(Start, Grid) || !IsWalkable(Goal, Grid) || !AreConnected(Start, Goal, Grid))
+        return NULL;
+
+    BeginCooperativeSearch(Search);
+    Theap *OpenList = &Search->OpenList;
+    int CellsLength = Search->CellsLength;
+
+    int StartSlot = Start.Row * Search->NumberCols + Start.Col;
+    search_node *StartNode = RefreshNode(&Search->Nodes[StartSlot], Search->SearchId);
+    StartNode->Parent = (point) {StartSlot, 0};
+    StartNode->g = 0.0;
+    StartNode->h = CooperativeEstimate(Start, Goal, Grid);
+    StartNode->f = StartNode->h;
+    PushHeap(OpenList, (point) {StartSlot, 0});
+
+    int Last = -1, Deepest = StartSlot;
+    while (!IsHeapEmpty(OpenList)) {
+        int Slot = PopHeap(OpenList).Row;
+        search_node *RefNode = &Search->Nodes[Slot];
+        RefNode->Closed = true;
+        Search->Expanded++;
+
+        if (RefNode->g > Search->Nodes[Deepest].g || (RefNode->g == Search->Nodes[Deepest].g && RefNode->h < Search->Nodes[Deepest].h))
+            Deepest = Slot;
+
+        int Offset = Slot / CellsLength;
+        point Location = {(Slot % CellsLength) / Search->NumberCols, (Slot % CellsLength) % Search->NumberCols};
+        if (EqualPoints(Location, Goal) || Offset == Search->Horizon - 1) {
+            Last = Slot;
+            break;
+        }
+
+        unsigned int Tick = Table->Now + Offset;
+        for (int m = 0; m < 5; m++) {
+            point Next = {Location.Row + CooperativeMoves[m][0], Location.Col + CooperativeMoves[m][1]};
+            if (!IsWalkable(Next, Grid) || !IsStepFree(Table, Location, Next, Tick, Agent))
+                continue;
+
+            // every way into a slot takes the same number of ticks, so the first one is as good as any
+            int NextSlot = (Offset + 1) * CellsLength + Next.Row * Search->NumberCols + Next.Col;
+            search_node *NextNode = RefreshNode(&Search->Nodes[NextSlot], Search->SearchId);
+            if (NextNode->f >= 0)
+                continue;
+
+            NextNode->g = RefNode->g + 1.0;
+            NextNode->h = CooperativeEstimate(Next, Goal, Grid);
+            NextNode->f = NextNode->g + NextNode->h;
+            NextNode->Parent = (point) {Slot, 0};
+            PushHeap(OpenList, (point) {NextSlot, 0});
+        }
+    }
+
+    // boxed in for part of the window: keep to the ticks that are safe and plan again from there
+    if (Last < 0)
+        Last = Deepest;
+
+    Tpath *Steps = NewPath(Last / CellsLength + 1);
+    for (int Slot = Last, i = Steps->Length - 1; i >= 0; i--) {
+        int Cell = Slot % CellsLength;
+        Steps->Points[i] = (path_point) {Cell / Search->NumberCols, Cell % Search->NumberCols};
+        Slot = Search->Nodes[Slot].Parent.Row;
+    }
+
+    return Steps;
+}
+
+void DestroyCooperativeSearch(cooperative_search *Search)
+{
+    if (Search == NULL)
+        return;
+
+    DestroyHeap(&Search->OpenList);
+    free(Search->Nodes);
+    free(Search);
+}
@@ -0,0 +1,39 @@
+/*
+	Which taxi holds every cell over the next Horizon ticks, one tick
+	being the time a taxi takes to drive one cell. Slot (t % Horizon,
+	cell) only belongs to Owner while its Tick is t, so reservations
+	expire as Now moves on without ever being cleared.
+*/
+typedef struct reservation_table {
+	int Horizon;
+	int CellsLength, NumberCols;
+	unsigned int Now;
+	int *Owner;
+	unsigned int *Tick;
+} reservation_table;
+
+/*
+	Cooperative A* over (cell, tick) inside the reservation window. The
+	node of a cell Offset ticks from now is Offset * CellsLength + cell,
+	stored in one-column layout for the shared Theap. The estimate to
+	Goal is the Manhattan distance tightened with the grid's landmarks,
+	so a new Goal costs nothing to set up.
+*/
+typedef struct cooperative_search {
+	int Horizon;
+	int CellsLength, NumberCols;
+	search_node *Nodes;
+	Theap OpenList;
+	unsigned int SearchId;
+	int Expanded;
+} cooperative_search;
+
+reservation_table *	CreateReservationTable(astar_grid *Grid, int Horizon);
+void 				AdvanceReservations(reservation_table *Table);
+int 				ReservationOwner(reservation_table *Table, point Location, unsigned int Tick);
+void 				ReserveSteps(reservation_table *Table, Tpath *Steps, unsigned int FromTick, int Agent);
+void 				ReleaseSteps(reservation_table *Table, Tpath *Steps, unsigned int FromTick, int Agent);
+void 				DestroyReservationTable(reservation_table *Table);
+cooperative_search *CreateCooperativeSearch(astar_grid *Grid, int Horizon);
+Tpath *				FindPathCooperative(point Start, point Goal, int Agent, reservation_table *Table, astar_grid *Grid, cooperative_search *Search);
+void 				DestroyCooperativeSearch(cooperative_search *Search);
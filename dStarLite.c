@@ -0,0 +1,260 @@
+#include "dStarLite.h"
+
+static const int DStarDirections[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+static int DStarIndex(dstar_search *Search, point Location) 
+{
+    return Location.Row * Search->NumberCols + Location.Col;
+}
+
+/*
+    Same lazy reset as the A* scratch: a node whose Stamp is not the
+    current SearchId has never been seen by this search, so g and rhs
+    are infinite.
+*/
+static search_node * DStarNode(dstar_search *Search, point Location) 
+{
+    int i = DStarIndex(Search, Location);
+    search_node *Node = &Search->Nodes[i];
+    if (Node->Stamp != Search->SearchId) {
+        Node->Stamp = Search->SearchId;
+        Node->g = INFINITY;
+        Node->f = INFINITY;
+        Node->h = INFINITY;
+        Node->HeapIndex = -1;
+        Node->Closed = false;
+        Search->Rhs[i] = INFINITY;
+    }
+
+    return Node;
+}
+
+static double DStarEdgeCost(point From, point To, astar_grid *Grid) 
+{
+    if (!IsWalkable(From, Grid) || !IsWalkable(To, Grid))
+        return INFINITY;
+    return 1.0;
+}
+
+static void DStarCalculateKey(dstar_search *Search, point Location, search_node *Node) 
+{
+    double Best = fmin(Node->g, Search->Rhs[DStarIndex(Search, Location)]);
+    Node->f = Best + abs(Location.Row - Search->Start.Row) + abs(Location.Col - Search->Start.Col) + Search->KeyModifier;
+    Node->h = Best;
+}
+
+static void DStarUpdateVertex(dstar_search *Search, point Location, astar_grid *Grid) 
+{
+    search_node *Node = DStarNode(Search, Location);
+    int i = DStarIndex(Search, Location);
+
+    if (!EqualPoints(Location, Search->Goal)) {
+        double Rhs = INFINITY;
+        for (int d = 0; d < 4; d++) {
+            point Next = {Location.Row + DStarDirections[d][0], Location.Col + DStarDirections[d][1]};
+            double Cost = DStarEdgeCost(Location, Next, Grid);
+            if (Cost == INFINITY)
+                continue;
+            Rhs = fmin(Rhs, Cost + DStarNode(Search, Next)->g);
+        }
+        Search->Rhs[i] = Rhs;
+    }
+
+    if (Node->g != Search->Rhs[i]) {
+        DStarCalculateKey(Search, Location, Node);
+        UpdateKeyHeap(&Search->OpenList, Location);
+    } else {
+        RemoveHeap(&Search->OpenList, Location);
+    }
+}
+
+static bool DStarKeyLess(double f1, double h1, double f2, double h2) 
+{
+    if (f1 != f2)
+        return f1 < f2;
+    return h1 < h2;
+}
+
+static void DStarUpdateNeighbours(dstar_search *Search, point Location, astar_grid *Grid) 
+{
+    for (int d = 0; d < 4; d++) {
+        point Next = {Location.Row + DStarDirections[d][0], Location.Col + DStarDirections[d][1]};
+        if (IsWalkable(Next, Grid))
+            DStarUpdateVertex(Search, Next, Grid);
+    }
+}
+
+static void DStarComputeShortestPath(dstar_search *Search, astar_grid *Grid) 
+{
+    search_node Start = *DStarNode(Search, Search->Start);
+    DStarCalculateKey(Search, Search->Start, &Start);
+
+    while (!IsHeapEmpty(&Search->OpenList)) {
+        point Top = Search->OpenList.Nodes[0];
+        search_node *Node = DStarNode(Search, Top);
+        double StartRhs = Search->Rhs[DStarIndex(Search, Search->Start)];
+        if (!DStarKeyLess(Node->f, Node->h, Start.f, Start.h) && StartRhs == Start.g)
+            break;
+
+        Search->Expanded++;
+        double OldF = Node->f, OldH = Node->h;
+        DStarCalculateKey(Search, Top, Node);
+        double Rhs = Search->Rhs[DStarIndex(Search, Top)];
+
+        if (DStarKeyLess(OldF, OldH, Node->f, Node->h)) {
+            UpdateKeyHeap(&Search->OpenList, Top);
+        } else if (Node->g > Rhs) {
+            Node->g = Rhs;
+            RemoveHeap(&Search->OpenList, Top);
+            DStarUpdateNeighbours(Search, Top, Grid);
+        } else {
+            Node->g = INFINITY;
+            DStarUpdateVertex(Search, Top, Grid);
+            DStarUpdateNeighbours(Search, Top, Grid);
+        }
+
+        Start = *DStarNode(Search, Search->Start);
+        DStarCalculateKey(Search, Search->Start, &Start);
+    }
+}
+
+/*
+    Walks downhill on g from Start; every step picks the neighbour that
+    is cheapest to finish from.
+*/
+static Tpath * DStarTracePath(dstar_search *Search, astar_grid *Grid) 
+{
+    if (DStarNode(Search, Search->Start)->g == INFINITY)
+        return NULL;
+
+    int Length = (int) DStarNode(Search, Search->Start)->g + 1;
+    Tpath *Path = NewPath(Length);
+    point Current = Search->Start;
+    Path->Points[0] = (path_point) {Current.Row, Current.Col};
+
+    for (int i = 1; i < Length; i++) {
+        point Best = Current;
+        double BestCost = INFINITY;
+        for (int d = 0; d < 4; d++) {
+            point Next = {Current.Row + DStarDirections[d][0], Current.Col + DStarDirections[d][1]};
+            double Cost = DStarEdgeCost(Current, Next, Grid);
+            if (Cost == INFINITY)
+                continue;
+            Cost += DStarNode(Search, Next)->g;
+            if (Cost < BestCost) {
+                BestCost = Cost;
+                Best = Next;
+            }
+        }
+
+        if (BestCost == INFINITY) {
+            DestroyPath(&Path);
+            return NULL;
+        }
+
+        Current = Best;
+        Path->Points[i] = (path_point) {Current.Row, Current.Col};
+    }
+
+    return CompressPath(Path);
+}
+
+dstar_search * CreateDStarSearch(astar_grid *Grid) 
+{
+    dstar_search *Search = (dstar_search*) malloc(sizeof(dstar_search));
+    Search->NumberRows = Grid->NumberRows;
+    Search->NumberCols = Grid->NumberCols;
+    Search->Nodes = (search_node*) calloc(Grid->NumberRows * Grid->NumberCols, sizeof(search_node));
+    Search->Rhs = (double*) malloc(Grid->NumberRows * Grid->NumberCols * sizeof(double));
+    Search->SearchId = 0;
+    Search->KeyModifier = 0.0;
+    Search->Version = Grid->Version;
+    Search->Expanded = 0;
+    InitHeap(&Search->OpenList, 64, Search->Nodes, Search->NumberCols);
+
+    return Search;
+}
+
+/*
+    Starts over towards a new Goal. The g and rhs values of the previous
+    goal are dropped by moving to a new SearchId.
+*/
+Tpath * DStarFindPath(dstar_search *Search, point Start, point Goal, astar_grid *Grid) 
+{
+    Search->SearchId++;
+    if (Search->SearchId == 0) {
+        for (int i = 0; i < Search->NumberRows * Search->NumberCols; i++) {
+            Search->Nodes[i].Stamp = 0;
+        }
+        Search->SearchId = 1;
+    }
+
+    Search->OpenList.Size = 0;
+    Search->Start = Search->Last = Start;
+    Search->Goal = Goal;
+    Search->KeyModifier = 0.0;
+    Search->Version = Grid->Version;
+    Search->Expanded = 0;
+
+    search_node *Node = DStarNode(Search, Goal);
+    Search->Rhs[DStarIndex(Search, Goal)] = 0.0;
+    DStarCalculateKey(Search, Goal, Node);
+    PushHeap(&Search->OpenList, Goal);
+
+    DStarComputeShortestPath(Search, Grid);
+    return DStarTracePath(Search, Grid);
+}
+
+/*
+    Tells the search that Location changed passability: every edge
+    touching it changed cost, so the cell and its four neighbours get
+    their rhs recomputed. Call once per changed cell, then DStarReplan.
+*/
+void DStarUpdateCell(dstar_search *Search, point Location, astar_grid *Grid) 
+{
+    DStarUpdateVertex(Search, Location, Grid);
+    for (int d = 0; d < 4; d++) {
+        point Next = {Location.Row + DStarDirections[d][0], Location.Col + DStarDirections[d][1]};
+        if (Next.Row >= 0 && Next.Row < Grid->NumberRows && Next.Col >= 0 && Next.Col < Grid->NumberCols)
+            DStarUpdateVertex(Search, Next, Grid);
+    }
+
+    Search->Version = Grid->Version;
+}
+
+/*
+    Repairs the path from the agent's current cell after it moved and
+    cells changed, reusing everything the earlier searches settled.
+*/
+Tpath * DStarReplan(dstar_search *Search, point Start, astar_grid *Grid) 
+{
+    Search->Start = Start;
+    Search->KeyModifier += abs(Search->Last.Row - Start.Row) + abs(Search->Last.Col - Start.Col);
+    Search->Last = Start;
+    Search->Expanded = 0;
+
+    DStarComputeShortestPath(Search, Grid);
+    return DStarTracePath(Search, Grid);
+}
+
+/*
+    True when the search already plans towards Goal and has been told
+    about every grid edit but the latest one, so it can be repaired
+    incrementally.
+*/
+bool DStarIsTracking(dstar_search *Search, point Goal, astar_grid *Grid) 
+{
+    return Search != NULL && Search->SearchId != 0 && EqualPoints(Search->Goal, Goal) 
+        && Search->Version + 1 == Grid->Version;
+}
+
+void DestroyDStarSearch(dstar_search *Search) 
+{
+    if (Search == NULL)
+        return;
+
+    DestroyHeap(&Search->OpenList);
+    free(Search->Rhs);
+    free(Search->Nodes);
+    free(Search);
+}
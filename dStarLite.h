@@ -0,0 +1,26 @@
+/*
+	Incremental planner for a single moving agent (D* Lite). The search
+	grows backward from Goal, so its g values stay valid while Start
+	moves towards it and a changed cell only costs a local repair
+	instead of a new search. Keys live in the search_node f (primary)
+	and h (secondary) fields so the shared Theap orders them.
+*/
+typedef struct dstar_search {
+	int NumberRows, NumberCols;
+	search_node *Nodes;
+	double *Rhs;
+	Theap OpenList;
+	unsigned int SearchId;
+
+	point Start, Goal, Last;
+	double KeyModifier;
+	unsigned int Version;
+	int Expanded;
+} dstar_search;
+
+dstar_search *		CreateDStarSearch(astar_grid *Grid);
+Tpath *				DStarFindPath(dstar_search *Search, point Start, point Goal, astar_grid *Grid);
+void 				DStarUpdateCell(dstar_search *Search, point Location, astar_grid *Grid);
+Tpath *				DStarReplan(dstar_search *Search, point Start, astar_grid *Grid);
+bool 				DStarIsTracking(dstar_search *Search, point Goal, astar_grid *Grid);
+void 				DestroyDStarSearch(dstar_search *Search);
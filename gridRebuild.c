@@ -0,0 +1,181 @@
+#include "gridRebuild.h"
+
+grid_rebuild * CreateGridRebuild(astar_grid *Grid)
+{
+    grid_rebuild *Rebuild = (grid_rebuild*) malloc(sizeof(grid_rebuild));
+    astar_grid *Snapshot = &Rebuild->Snapshot;
+    Snapshot->NumberRows = Grid->NumberRows;
+    Snapshot->NumberCols = Grid->NumberCols;
+    Snapshot->IsOpenCellFunction = Grid->IsOpenCellFunction;
+    Snapshot->Version = Grid->Version;
+    Snapshot->Map = (cell**) malloc(Grid->NumberRows * sizeof(cell*));
+    for (int i = 0; i < Grid->NumberRows; i++) {
+        Snapshot->Map[i] = (cell*) malloc(Grid->NumberCols * sizeof(cell));
+        memcpy(Snapshot->Map[i], Grid->Map[i], Grid->NumberCols * sizeof(cell));
+    }
+
+    Snapshot->Landmarks = NULL;
+    Snapshot->Hierarchy = NULL;
+    Snapshot->Roads = NULL;
+    Snapshot->Contraction = NULL;
+    Snapshot->HubLabels = NULL;
+    Snapshot->Components = NULL;
+    Snapshot->Passability = CreatePassability(Snapshot);
+
+    Rebuild->LandmarksLength = Grid->Landmarks != NULL ? Grid->Landmarks->Capacity : 0;
+    Rebuild->ClusterSize = Grid->Hierarchy != NULL ? Grid->Hierarchy->ClusterSize : 0;
+    Rebuild->WithContraction = Grid->Contraction != NULL;
+    Rebuild->WithHubLabels = Grid->HubLabels != NULL;
+    Rebuild->Running = false;
+    Rebuild->Done = false;
+    pthread_mutex_init(&Rebuild->Lock, NULL);
+
+    return Rebuild;
+}
+
+/* True when one of the tables the thread rebuilds is behind the map. */
+bool IsGridStale(astar_grid *Grid)
+{
+    return (Grid->Landmarks != NULL && Grid->Landmarks->Version != Grid->Version)
+        || (Grid->Hierarchy != NULL && Grid->Hierarchy->Version != Grid->Version)
+        || (Grid->Roads != NULL && Grid->Roads->Version != Grid->Version)
+        || (Grid->Contraction != NULL && Grid->Contraction->Version != Grid->Version)
+        || (Grid->HubLabels != NULL && Grid->HubLabels->Version != Grid->Version);
+}
+
+static void * RebuildGridTables(void *Argument)
+{
+    grid_rebuild *Rebuild = (grid_rebuild*) Argument;
+    astar_grid *Snapshot = &Rebuild->Snapshot;
+
+    if (Rebuild->LandmarksLength > 0)
+        Snapshot->Landmarks = CreateLandmarks(Snapshot, Rebuild->LandmarksLength);
+    if (Rebuild->ClusterSize > 0)
+        Snapshot->Hierarchy = CreateHierarchy(Snapshot, Rebuild->ClusterSize);
+
+    // the contraction is built on the road graph, and the labels on the contraction
+    Snapshot->Roads = CreateRoadGraph(Snapshot);
+    if (Rebuild->WithContraction || Rebuild->WithHubLabels)
+        Snapshot->Contraction = CreateContraction(Snapshot);
+    if (Rebuild->WithHubLabels)
+        Snapshot->HubLabels = CreateHubLabels(Snapshot);
+
+    pthread_mutex_lock(&Rebuild->Lock);
+    Rebuild->Done = true;
+    pthread_mutex_unlock(&Rebuild->Lock);
+
+    return NULL;
+}
+
+/* Copies the map as it is now and starts building from it. */
+void StartGridRebuild(grid_rebuild *Rebuild, astar_grid *Grid)
+{
+    if (Rebuild->Running)
+        return;
+
+    astar_grid *Snapshot = &Rebuild->Snapshot;
+    for (int i = 0; i < Grid->NumberRows; i++) {
+        memcpy(Snapshot->Map[i], Grid->Map[i], Grid->NumberCols * sizeof(cell));
+    }
+    Snapshot->Version = Grid->Version;
+    BuildPassability(Snapshot->Passability, Snapshot);
+
+    Rebuild->Done = false;
+    if (pthread_create(&Rebuild->Thread, NULL, RebuildGridTables, Rebuild) != 0) {
+        DEBUG_PRINTL("Could not start the grid rebuild\n");
+        return;
+    }
+
+    Rebuild->Running = true;
+}
+
+static void DropSnapshotTables(astar_grid *Snapshot)
+{
+    if (Snapshot->Landmarks != NULL)
+        DestroyLandmarks(Snapshot->Landmarks);
+    if (Snapshot->Hierarchy != NULL)
+        DestroyHierarchy(Snapshot->Hierarchy);
+    if (Snapshot->Roads != NULL)
+        DestroyRoadGraph(Snapshot->Roads);
+    if (Snapshot->Contraction != NULL)
+        DestroyContraction(Snapshot->Contraction);
+    if (Snapshot->HubLabels != NULL)
+        DestroyHubLabels(Snapshot->HubLabels);
+
+    Snapshot->Landmarks = NULL;
+    Snapshot->Hierarchy = NULL;
+    Snapshot->Roads = NULL;
+    Snapshot->Contraction = NULL;
+    Snapshot->HubLabels = NULL;
+}
+
+/*
+    Collects a build the thread has finished, without waiting for one
+    that has not. Has to be called while nothing else reads Grid (the
+    planner between BeginGridEdit and EndGridEdit). Returns true when
+    the tables were swapped in.
+*/
+bool FinishGridRebuild(grid_rebuild *Rebuild, astar_grid *Grid)
+{
+    if (!Rebuild->Running)
+        return false;
+
+    pthread_mutex_lock(&Rebuild->Lock);
+    bool Done = Rebuild->Done;
+    pthread_mutex_unlock(&Rebuild->Lock);
+    if (!Done)
+        return false;
+
+    pthread_join(Rebuild->Thread, NULL);
+    Rebuild->Running = false;
+
+    astar_grid *Snapshot = &Rebuild->Snapshot;
+    bool Current = Snapshot->Version == Grid->Version;
+    // the old tables go to the snapshot and are freed with what it did not use
+    if (Current && Grid->Landmarks != NULL) {
+        landmarks *Old = Grid->Landmarks;
+        Grid->Landmarks = Snapshot->Landmarks;
+        Snapshot->Landmarks = Old;
+    }
+    if (Current && Grid->Hierarchy != NULL) {
+        hpa_graph *Old = Grid->Hierarchy;
+        Grid->Hierarchy = Snapshot->Hierarchy;
+        Snapshot->Hierarchy = Old;
+    }
+    if (Current && Grid->Roads != NULL) {
+        road_graph *Old = Grid->Roads;
+        Grid->Roads = Snapshot->Roads;
+        Snapshot->Roads = Old;
+    }
+    if (Current && Grid->Contraction != NULL) {
+        ch_graph *Old = Grid->Contraction;
+        Grid->Contraction = Snapshot->Contraction;
+        Snapshot->Contraction = Old;
+    }
+    if (Current && Grid->HubLabels != NULL) {
+        hub_labels *Old = Grid->HubLabels;
+        Grid->HubLabels = Snapshot->HubLabels;
+        Snapshot->HubLabels = Old;
+    }
+
+    DropSnapshotTables(Snapshot);
+
+    return Current;
+}
+
+void DestroyGridRebuild(grid_rebuild *Rebuild)
+{
+    if (Rebuild->Running) {
+        pthread_join(Rebuild->Thread, NULL);
+        Rebuild->Running = false;
+    }
+
+    DropSnapshotTables(&Rebuild->Snapshot);
+    DestroyPassability(Rebuild->Snapshot.Passability);
+    for (int i = 0; i < Rebuild->Snapshot.NumberRows; i++) {
+        free(Rebuild->Snapshot.Map[i]);
+    }
+    free(Rebuild->Snapshot.Map);
+    pthread_mutex_destroy(&Rebuild->Lock);
+    free(Rebuild);
+}
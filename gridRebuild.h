@@ -0,0 +1,25 @@
+/*
+	Rebuilds the tables derived from the map on a thread of its own, so
+	a road edit does not stall the frame it happens in. The thread works
+	on Snapshot, a copy of the map taken when the build starts, and only
+	builds the tables the live grid has. The finished tables are swapped
+	in when the grid is still at the Version they were built for and
+	thrown away otherwise; until then searches fall back as they do for
+	any out of date table.
+*/
+typedef struct grid_rebuild {
+	pthread_t Thread;
+	pthread_mutex_t Lock;
+	astar_grid Snapshot;
+	int LandmarksLength;
+	int ClusterSize;
+	bool WithContraction;
+	bool WithHubLabels;
+	bool Running, Done;
+} grid_rebuild;
+
+grid_rebuild *		CreateGridRebuild(astar_grid *Grid);
+bool 				IsGridStale(astar_grid *Grid);
+void 				StartGridRebuild(grid_rebuild *Rebuild, astar_grid *Grid);
+bool 				FinishGridRebuild(grid_rebuild *Rebuild, astar_grid *Grid);
+void 				DestroyGridRebuild(grid_rebuild *Rebuild);
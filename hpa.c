@@ -0,0 +1,440 @@
+#include "hpa.h"
+
+static int GetCluster(hpa_graph *Hierarchy, point Location) 
+{
+    return (Location.Row / Hierarchy->ClusterSize) * Hierarchy->ClusterCols + Location.Col / Hierarchy->ClusterSize;
+}
+
+static void AddHierarchyEdge(hpa_node *Node, int To, int Cost) 
+{
+    for (int i = 0; i < Node->EdgesLength; i++) {
+        if (Node->Edges[i].To == To) {
+            if (Cost < Node->Edges[i].Cost)
+                Node->Edges[i].Cost = Cost;
+            return;
+        }
+    }
+
+    if (Node->EdgesLength >= Node->EdgesCapacity) {
+        Node->EdgesCapacity = Node->EdgesCapacity > 0 ? Node->EdgesCapacity * 2 : 8;
+        Node->Edges = (hpa_edge*) realloc(Node->Edges, Node->EdgesCapacity * sizeof(hpa_edge));
+    }
+
+    Node->Edges[Node->EdgesLength++] = (hpa_edge) {To, Cost};
+}
+
+static int AddHierarchyNode(hpa_graph *Hierarchy, astar_grid *Grid, point Location) 
+{
+    int Index = Location.Row * Grid->NumberCols + Location.Col;
+    if (Hierarchy->NodeAt[Index] >= 0)
+        return Hierarchy->NodeAt[Index];
+
+    if (Hierarchy->NodesLength >= Hierarchy->NodesCapacity) {
+        Hierarchy->NodesCapacity = Hierarchy->NodesCapacity > 0 ? Hierarchy->NodesCapacity * 2 : 64;
+        Hierarchy->Nodes = (hpa_node*) realloc(Hierarchy->Nodes, Hierarchy->NodesCapacity * sizeof(hpa_node));
+    }
+
+    hpa_node *Node = &Hierarchy->Nodes[Hierarchy->NodesLength];
+    Node->Location = Location;
+    Node->Cluster = GetCluster(Hierarchy, Location);
+    Node->Edges = NULL;
+    Node->EdgesLength = 0;
+    Node->EdgesCapacity = 0;
+
+    Hierarchy->NodeAt[Index] = Hierarchy->NodesLength;
+    return Hierarchy->NodesLength++;
+}
+
+static void AddTransition(hpa_graph *Hierarchy, astar_grid *Grid, point Inside, point Outside) 
+{
+    int A = AddHierarchyNode(Hierarchy, Grid, Inside);
+    int B = AddHierarchyNode(Hierarchy, Grid, Outside);
+    AddHierarchyEdge(&Hierarchy->Nodes[A], B, 1);
+    AddHierarchyEdge(&Hierarchy->Nodes[B], A, 1);
+}
+
+/*
+    Walks the border between two clusters, one cell pair at a time 
+    (Step moves along the border, Across crosses it). Short open 
+    stretches get one transition in the middle, long ones one per end.
+*/
+static void FindEntrances(hpa_graph *Hierarchy, astar_grid *Grid, point First, point Step, point Across, int Length) 
+{
+    int RunStart = -1;
+
+    for (int i = 0; i <= Length; i++) {
+        point Inside = {First.Row + i * Step.Row, First.Col + i * Step.Col};
+        point Outside = {Inside.Row + Across.Row, Inside.Col + Across.Col};
+        bool Open = i < Length && IsWalkable(Inside, Grid) && IsWalkable(Outside, Grid);
+
+        if (Open && RunStart < 0) {
+            RunStart = i;
+        } else if (!Open && RunStart >= 0) {
+            int RunEnd = i - 1;
+            if (RunEnd - RunStart + 1 < 6) {
+                int Middle = (RunStart + RunEnd) / 2;
+                point Cell = {First.Row + Middle * Step.Row, First.Col + Middle * Step.Col};
+                AddTransition(Hierarchy, Grid, Cell, (point) {Cell.Row + Across.Row, Cell.Col + Across.Col});
+            } else {
+                point Cell = {First.Row + RunStart * Step.Row, First.Col + RunStart * Step.Col};
+                AddTransition(Hierarchy, Grid, Cell, (point) {Cell.Row + Across.Row, Cell.Col + Across.Col});
+                Cell = (point) {First.Row + RunEnd * Step.Row, First.Col + RunEnd * Step.Col};
+                AddTransition(Hierarchy, Grid, Cell, (point) {Cell.Row + Across.Row, Cell.Col + Across.Col});
+            }
+            RunStart = -1;
+        }
+    }
+}
+
+/*
+    Breadth-first distances from Source that never leave its cluster.
+    Distances and Queue are indexed by the cell's offset in the cluster.
+*/
+static void ClusterDistances(hpa_graph *Hierarchy, astar_grid *Grid, point Source, int *Distances, int *Queue) 
+{
+    const int Directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    int Size = Hierarchy->ClusterSize;
+    point Origin = {(Source.Row / Size) * Size, (Source.Col / Size) * Size};
+
+    for (int i = 0; i < Size * Size; i++) {
+        Distances[i] = -1;
+    }
+
+    int Head = 0, Tail = 0;
+    Distances[(Source.Row - Origin.Row) * Size + Source.Col - Origin.Col] = 0;
+    Queue[Tail++] = (Source.Row - Origin.Row) * Size + Source.Col - Origin.Col;
+
+    while (Head < Tail) {
+        int Offset = Queue[Head++];
+        point Current = {Origin.Row + Offset / Size, Origin.Col + Offset % Size};
+
+        for (int k = 0; k < 4; k++) {
+            point Neighbour = {Current.Row + Directions[k][0], Current.Col + Directions[k][1]};
+            if (Neighbour.Row < Origin.Row || Neighbour.Row >= Origin.Row + Size || 
+                Neighbour.Col < Origin.Col || Neighbour.Col >= Origin.Col + Size || !IsWalkable(Neighbour, Grid))
+                continue;
+
+            int NeighbourOffset = (Neighbour.Row - Origin.Row) * Size + Neighbour.Col - Origin.Col;
+            if (Distances[NeighbourOffset] >= 0)
+                continue;
+
+            Distances[NeighbourOffset] = Distances[Offset] + 1;
+            Queue[Tail++] = NeighbourOffset;
+        }
+    }
+}
+
+static int ClusterOffset(hpa_graph *Hierarchy, point Location) 
+{
+    int Size = Hierarchy->ClusterSize;
+    return (Location.Row % Size) * Size + Location.Col % Size;
+}
+
+static void ClearHierarchy(hpa_graph *Hierarchy) 
+{
+    for (int i = 0; i < Hierarchy->NodesLength; i++) {
+        free(Hierarchy->Nodes[i].Edges);
+    }
+
+    Hierarchy->NodesLength = 0;
+}
+
+hpa_graph * CreateHierarchy(astar_grid *Grid, int ClusterSize) 
+{
+    hpa_graph *Hierarchy = (hpa_graph*) malloc(sizeof(hpa_graph));
+    Hierarchy->ClusterSize = ClusterSize;
+    Hierarchy->ClusterRows = (Grid->NumberRows + ClusterSize - 1) / ClusterSize;
+    Hierarchy->ClusterCols = (Grid->NumberCols + ClusterSize - 1) / ClusterSize;
+    Hierarchy->Nodes = NULL;
+    Hierarchy->NodesLength = 0;
+    Hierarchy->NodesCapacity = 0;
+    Hierarchy->NodeAt = (int*) malloc(Grid->NumberRows * Grid->NumberCols * sizeof(int));
+    Hierarchy->ClusterStart = (int*) malloc((Hierarchy->ClusterRows * Hierarchy->ClusterCols + 1) * sizeof(int));
+    Hierarchy->ClusterNodes = NULL;
+    BuildHierarchy(Hierarchy, Grid);
+
+    return Hierarchy;
+}
+
+void BuildHierarchy(hpa_graph *Hierarchy, astar_grid *Grid) 
+{
+    int Size = Hierarchy->ClusterSize;
+    int ClustersLength = Hierarchy->ClusterRows * Hierarchy->ClusterCols;
+
+    ClearHierarchy(Hierarchy);
+    for (int i = 0; i < Grid->NumberRows * Grid->NumberCols; i++) {
+        Hierarchy->NodeAt[i] = -1;
+    }
+
+    // entrances on every horizontal and vertical border between clusters
+    for (int Row = Size; Row < Grid->NumberRows; Row += Size) {
+        for (int Col = 0; Col < Grid->NumberCols; Col += Size) {
+            int Length = Col + Size <= Grid->NumberCols ? Size : Grid->NumberCols - Col;
+            FindEntrances(Hierarchy, Grid, (point) {Row - 1, Col}, (point) {0, 1}, (point) {1, 0}, Length);
+        }
+    }
+
+    for (int Col = Size; Col < Grid->NumberCols; Col += Size) {
+        for (int Row = 0; Row < Grid->NumberRows; Row += Size) {
+            int Length = Row + Size <= Grid->NumberRows ? Size : Grid->NumberRows - Row;
+            FindEntrances(Hierarchy, Grid, (point) {Row, Col - 1}, (point) {1, 0}, (point) {0, 1}, Length);
+        }
+    }
+
+    // group the nodes by cluster
+    for (int c = 0; c <= ClustersLength; c++) {
+        Hierarchy->ClusterStart[c] = 0;
+    }
+    for (int i = 0; i < Hierarchy->NodesLength; i++) {
+        Hierarchy->ClusterStart[Hierarchy->Nodes[i].Cluster + 1]++;
+    }
+    for (int c = 0; c < ClustersLength; c++) {
+        Hierarchy->ClusterStart[c + 1] += Hierarchy->ClusterStart[c];
+    }
+
+    Hierarchy->ClusterNodes = (int*) realloc(Hierarchy->ClusterNodes, (Hierarchy->NodesLength + 1) * sizeof(int));
+    int *Fill = (int*) malloc(ClustersLength * sizeof(int));
+    memcpy(Fill, Hierarchy->ClusterStart, ClustersLength * sizeof(int));
+    for (int i = 0; i < Hierarchy->NodesLength; i++) {
+        Hierarchy->ClusterNodes[Fill[Hierarchy->Nodes[i].Cluster]++] = i;
+    }
+    free(Fill);
+
+    // intra-cluster edges between entrances that can reach each other
+    int *Distances = (int*) malloc(Size * Size * sizeof(int));
+    int *Queue = (int*) malloc(Size * Size * sizeof(int));
+    for (int i = 0; i < Hierarchy->NodesLength; i++) {
+        hpa_node *Node = &Hierarchy->Nodes[i];
+        ClusterDistances(Hierarchy, Grid, Node->Location, Distances, Queue);
+
+        for (int k = Hierarchy->ClusterStart[Node->Cluster]; k < Hierarchy->ClusterStart[Node->Cluster + 1]; k++) {
+            int j = Hierarchy->ClusterNodes[k];
+            int Distance = Distances[ClusterOffset(Hierarchy, Hierarchy->Nodes[j].Location)];
+            if (j != i && Distance > 0)
+                AddHierarchyEdge(Node, j, Distance);
+        }
+    }
+    free(Queue);
+    free(Distances);
+
+    Hierarchy->Version = Grid->Version;
+}
+
+void DestroyHierarchy(hpa_graph *Hierarchy) 
+{
+    ClearHierarchy(Hierarchy);
+    free(Hierarchy->Nodes);
+    free(Hierarchy->NodeAt);
+    free(Hierarchy->ClusterStart);
+    free(Hierarchy->ClusterNodes);
+    free(Hierarchy);
+}
+
+/* The entrance node of Cluster at Location, or -1 when there is none. */
+static int FindEntranceAt(hpa_graph *Hierarchy, int Cluster, point Location) 
+{
+    for (int k = Hierarchy->ClusterStart[Cluster]; k < Hierarchy->ClusterStart[Cluster + 1]; k++) {
+        int j = Hierarchy->ClusterNodes[k];
+        if (EqualPoints(Hierarchy->Nodes[j].Location, Location))
+            return j;
+    }
+
+    return -1;
+}
+
+/*
+    A* over the abstract graph. Start and End are plugged in as two extra
+    nodes linked to the entrances of their own clusters. The abstract 
+    nodes are laid out as a one-column grid in the search's stamped
+    GraphNodes, so the cell heap orders them as they are.
+
+    Returns the waypoints (Start, entrances..., End) as a Tpath, or NULL
+    when End cannot be reached.
+*/
+Tpath * FindHierarchicalRoute(point Start, point End, astar_grid *Grid, astar_search *Search) 
+{
+    hpa_graph *Hierarchy = Grid->Hierarchy;
+
+    if (!AreConnected(Start, End, Grid) || EqualPoints(Start, End))
+        return NULL;
+
+    if (Hierarchy == NULL || Hierarchy->Version != Grid->Version) {
+        Tpath *Route = NewPath(2);
+        Route->Points[0] = (path_point) {Start.Row, Start.Col};
+        Route->Points[1] = (path_point) {End.Row, End.Col};
+        return Route;
+    }
+
+    int Size = Hierarchy->ClusterSize;
+    int *StartDistances = UseGraphDistances(Search, 3 * Size * Size);
+    int *EndDistances = StartDistances + Size * Size;
+    int *Queue = EndDistances + Size * Size;
+    int StartCluster = GetCluster(Hierarchy, Start);
+    int EndCluster = GetCluster(Hierarchy, End);
+
+    ClusterDistances(Hierarchy, Grid, Start, StartDistances, Queue);
+    ClusterDistances(Hierarchy, Grid, End, EndDistances, Queue);
+
+    if (StartCluster == EndCluster && StartDistances[ClusterOffset(Hierarchy, End)] >= 0) {
+        Tpath *Route = NewPath(2);
+        Route->Points[0] = (path_point) {Start.Row, Start.Col};
+        Route->Points[1] = (path_point) {End.Row, End.Col};
+        return Route;
+    }
+
+    int StartNode = Hierarchy->NodesLength;
+    int EndNode = Hierarchy->NodesLength + 1;
+    // a Start or End on an entrance is that node itself, not a link to it of no length
+    int Source = FindEntranceAt(Hierarchy, StartCluster, Start);
+    int Target = FindEntranceAt(Hierarchy, EndCluster, End);
+    if (Source < 0)
+        Source = StartNode;
+    if (Target < 0)
+        Target = EndNode;
+    BeginSearch(Search);
+    search_node *Nodes = UseGraphNodes(Search, Hierarchy->NodesLength + 2);
+    Theap *OpenList = &Search->GraphOpenList;
+
+    search_node *Root = TouchGraphNode(Source, Search);
+    Root->Parent = (point) {Source, 0};
+    Root->g = 0.0;
+    Root->h = abs(Start.Row - End.Row) + abs(Start.Col - End.Col);
+    Root->f = Root->h;
+    PushHeap(OpenList, (point) {Source, 0});
+
+    bool Found = false;
+    while (!IsHeapEmpty(OpenList)) {
+        int u = PopHeap(OpenList).Row;
+        Nodes[u].Closed = true;
+        Search->Expanded++;
+
+        if (u == Target) {
+            Found = true;
+            break;
+        }
+
+        // Start links to every entrance of its cluster it reaches, read straight off StartDistances
+        int Length = u == StartNode ? Hierarchy->ClusterStart[StartCluster + 1] - Hierarchy->ClusterStart[StartCluster] : Hierarchy->Nodes[u].EdgesLength;
+
+        // the goal hangs off every entrance of its cluster that reaches it
+        int ToEnd = -1;
+        if (Target == EndNode && u != StartNode && Hierarchy->Nodes[u].Cluster == EndCluster)
+            ToEnd = EndDistances[ClusterOffset(Hierarchy, Hierarchy->Nodes[u].Location)];
+
+        for (int k = 0; k <= Length; k++) {
+            hpa_edge Edge;
+            if (k < Length && u == StartNode) {
+                int j = Hierarchy->ClusterNodes[Hierarchy->ClusterStart[StartCluster] + k];
+                Edge = (hpa_edge) {j, StartDistances[ClusterOffset(Hierarchy, Hierarchy->Nodes[j].Location)]};
+                if (Edge.Cost <= 0)
+                    continue;
+            } else if (k < Length)
+                Edge = Hierarchy->Nodes[u].Edges[k];
+            else if (ToEnd >= 0)
+                Edge = (hpa_edge) {EndNode, ToEnd};
+            else
+                break;
+
+            search_node *Next = TouchGraphNode(Edge.To, Search);
+            if (Next->Closed)
+                continue;
+
+            point Location = Edge.To == EndNode ? End : Hierarchy->Nodes[Edge.To].Location;
+            double gNew = Nodes[u].g + Edge.Cost;
+            if (Next->f < 0 || gNew < Next->g) {
+                Next->g = gNew;
+                Next->h = abs(Location.Row - End.Row) + abs(Location.Col - End.Col);
+                Next->f = gNew + Next->h;
+                Next->Parent = (point) {u, 0};
+                DecreaseKeyHeap(OpenList, (point) {Edge.To, 0});
+            }
+        }
+    }
+
+    Tpath *Route = NULL;
+    if (Found) {
+        int Length = 1;
+        for (int u = Target; u != Source; u = Nodes[u].Parent.Row) {
+            Length++;
+        }
+
+        Route = NewPath(Length);
+        int i = Length - 1;
+        for (int u = Target; i >= 0; u = Nodes[u].Parent.Row, i--) {
+            point Location = u == EndNode ? End : (u == StartNode ? Start : Hierarchy->Nodes[u].Location);
+            Route->Points[i] = (path_point) {Location.Row, Location.Col};
+        }
+    }
+
+    return Route;
+}
+
+bool IsRouteRefined(Tpath *Route) 
+{
+    return Route == NULL || Route->Cursor >= Route->Length - 1;
+}
+
+/*
+    Ends of the next leg of an abstract route, without moving its cursor;
+    returns the waypoint the leg ends at, or -1 once the route is 
+    refined. A border crossing is merged with the leg behind it, so each
+    leg covers the drive across one cluster.
+*/
+int NextRouteLeg(Tpath *Route, point *From, point *To) 
+{
+    if (IsRouteRefined(Route))
+        return -1;
+
+    *From = GetPathPoint(Route, Route->Cursor);
+    int Next = Route->Cursor + 1;
+    // a waypoint repeated in the route is a leg of no length, merged with the next one
+    while (Next + 1 < Route->Length && EqualPoints(GetPathPoint(Route, Next), *From))
+        Next++;
+    *To = GetPathPoint(Route, Next);
+
+    if (abs(From->Row - To->Row) + abs(From->Col - To->Col) == 1 && Next + 1 < Route->Length) {
+        Next++;
+        *To = GetPathPoint(Route, Next);
+    }
+
+    return Next;
+}
+
+/*
+    Turns the next leg of an abstract route into cells and advances its
+    cursor.
+*/
+Tpath * RefineHierarchicalRoute(Tpath *Route, astar_grid *Grid, astar_search *Search) 
+{
+    point From, To;
+    int Next = NextRouteLeg(Route, &From, &To);
+    if (Next < 0)
+        return NULL;
+
+    Route->Cursor = Next;
+    if (!IsWalkable(From, Grid) || !IsWalkable(To, Grid))
+        return NULL;
+
+    return FindPathJPS(From, To, Grid, Search);
+}
+
+Tpath * FindPathHierarchical(point Start, point End, astar_grid *Grid, astar_search *Search) 
+{
+    Tpath *Route = FindHierarchicalRoute(Start, End, Grid, Search);
+    Tpath *Path = NULL;
+    int Expanded = Search->Expanded;
+
+    while (!IsRouteRefined(Route)) {
+        Tpath *Leg = RefineHierarchicalRoute(Route, Grid, Search);
+        Expanded += Search->Expanded;
+        if (Leg == NULL) {
+            DestroyPath(&Path);
+            break;
+        }
+        AppendPath(&Path, Leg);
+    }
+
+    Search->Expanded = Expanded;
+    DestroyPath(&Route);
+    return Path;
+}
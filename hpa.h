@@ -0,0 +1,37 @@
+typedef struct hpa_edge {
+	int To;
+	int Cost;
+} hpa_edge;
+
+typedef struct hpa_node {
+	point Location;
+	int Cluster;
+	hpa_edge *Edges;
+	int EdgesLength, EdgesCapacity;
+} hpa_node;
+
+/*
+	Abstract graph for hierarchical path finding: the grid is cut into
+	ClusterSize x ClusterSize clusters, every open stretch of a cluster 
+	border gets entrance nodes on both sides, and entrances of the same
+	cluster are linked by their road distance inside that cluster.
+*/
+typedef struct hpa_graph {
+	int ClusterSize;
+	int ClusterRows, ClusterCols;
+	unsigned int Version;
+
+	hpa_node *Nodes;
+	int NodesLength, NodesCapacity;
+	int *NodeAt;
+	int *ClusterStart;
+	int *ClusterNodes;
+} hpa_graph;
+
+hpa_graph *			CreateHierarchy(astar_grid *Grid, int ClusterSize);
+void 				BuildHierarchy(hpa_graph *Hierarchy, astar_grid *Grid);
+void 				DestroyHierarchy(hpa_graph *Hierarchy);
+Tpath *				FindHierarchicalRoute(point Start, point End, astar_grid *Grid, astar_search *Search);
+int 				NextRouteLeg(Tpath *Route, point *From, point *To);
+Tpath *				RefineHierarchicalRoute(Tpath *Route, astar_grid *Grid, astar_search *Search);
+bool 				IsRouteRefined(Tpath *Route);
@@ -0,0 +1,220 @@
+#include "hubLabels.h"
+
+static int CompareHubEntries(const void *A, const void *B)
+{
+    return ((hub_entry*) A)->Hub - ((hub_entry*) B)->Hub;
+}
+
+/*
+    Shortest distance through a hub both labels share, or -1.
+*/
+static int MergeHubLabels(hub_entry *A, int ALength, hub_entry *B, int BLength)
+{
+    int Best = -1;
+    int i = 0, j = 0;
+
+    while (i < ALength && j < BLength) {
+        if (A[i].Hub < B[j].Hub) {
+            i++;
+        } else if (A[i].Hub > B[j].Hub) {
+            j++;
+        } else {
+            int Distance = A[i].Distance + B[j].Distance;
+            if (Best < 0 || Distance < Best)
+                Best = Distance;
+            i++;
+            j++;
+        }
+    }
+
+    return Best;
+}
+
+static hub_entry * GetHubLabel(hub_labels *Labels, int u)
+{
+    return &Labels->Entries[Labels->LabelStart[u]];
+}
+
+hub_labels * CreateHubLabels(astar_grid *Grid)
+{
+    hub_labels *Labels = (hub_labels*) malloc(sizeof(hub_labels));
+    Labels->NodesLength = 0;
+    Labels->LabelStart = NULL;
+    Labels->LabelLength = NULL;
+    Labels->Entries = NULL;
+    Labels->EntriesLength = 0;
+    Labels->EntriesCapacity = 0;
+    BuildHubLabels(Labels, Grid);
+
+    return Labels;
+}
+
+/*
+    Goes through the nodes from the top of the hierarchy down: the label
+    of a node is itself plus the labels of its upward neighbours, each
+    pushed one edge further. An entry the label can already beat through
+    another hub is not a shortest distance and is dropped. Needs an up
+    to date Grid->Contraction.
+*/
+void BuildHubLabels(hub_labels *Labels, astar_grid *Grid)
+{
+    ch_graph *Contraction = Grid->Contraction;
+    int Length = Contraction->NodesLength;
+
+    Labels->NodesLength = Length;
+    Labels->LabelStart = (int*) realloc(Labels->LabelStart, (Length + 1) * sizeof(int));
+    Labels->LabelLength = (int*) realloc(Labels->LabelLength, (Length + 1) * sizeof(int));
+    Labels->EntriesLength = 0;
+
+    int *ByRank = (int*) malloc((Length + 1) * sizeof(int));
+    int *Best = (int*) malloc((Length + 1) * sizeof(int));
+    hub_entry *Label = (hub_entry*) malloc((Length + 1) * sizeof(hub_entry));
+    for (int u = 0; u < Length; u++) {
+        ByRank[Contraction->Rank[u]] = u;
+        Best[u] = -1;
+    }
+
+    for (int r = Length - 1; r >= 0; r--) {
+        int v = ByRank[r];
+        int LabelLength = 0;
+        Best[v] = 0;
+        Label[LabelLength++] = (hub_entry) {v, 0};
+
+        for (int k = Contraction->UpStart[v]; k < Contraction->UpStart[v + 1]; k++) {
+            ch_edge Edge = Contraction->Up[k];
+            hub_entry *Upper = GetHubLabel(Labels, Edge.To);
+
+            for (int i = 0; i < Labels->LabelLength[Edge.To]; i++) {
+                int Distance = Upper[i].Distance + Edge.Cost;
+                if (Best[Upper[i].Hub] < 0)
+                    Label[LabelLength++] = (hub_entry) {Upper[i].Hub, Distance};
+                if (Best[Upper[i].Hub] < 0 || Distance < Best[Upper[i].Hub])
+                    Best[Upper[i].Hub] = Distance;
+            }
+        }
+
+        for (int i = 0; i < LabelLength; i++) {
+            Label[i].Distance = Best[Label[i].Hub];
+            Best[Label[i].Hub] = -1;
+        }
+        qsort(Label, LabelLength, sizeof(hub_entry), CompareHubEntries);
+
+        int Kept = 0;
+        for (int i = 0; i < LabelLength; i++) {
+            int Hub = Label[i].Hub;
+            if (Hub == v || MergeHubLabels(Label, LabelLength, GetHubLabel(Labels, Hub), Labels->LabelLength[Hub]) >= Label[i].Distance)
+                Label[Kept++] = Label[i];
+        }
+
+        if (Labels->EntriesLength + Kept > Labels->EntriesCapacity) {
+            while (Labels->EntriesLength + Kept > Labels->EntriesCapacity) {
+                Labels->EntriesCapacity = Labels->EntriesCapacity > 0 ? Labels->EntriesCapacity * 2 : 1024;
+            }
+            Labels->Entries = (hub_entry*) realloc(Labels->Entries, Labels->EntriesCapacity * sizeof(hub_entry));
+        }
+
+        Labels->LabelStart[v] = Labels->EntriesLength;
+        Labels->LabelLength[v] = Kept;
+        memcpy(&Labels->Entries[Labels->EntriesLength], Label, Kept * sizeof(hub_entry));
+        Labels->EntriesLength += Kept;
+    }
+
+    free(Label);
+    free(Best);
+    free(ByRank);
+
+    Labels->Bytes = Labels->EntriesCapacity * sizeof(hub_entry) + 2 * (Length + 1) * sizeof(int);
+    Labels->Version = Contraction->Version;
+}
+
+void DestroyHubLabels(hub_labels *Labels)
+{
+    free(Labels->LabelStart);
+    free(Labels->LabelLength);
+    free(Labels->Entries);
+    free(Labels);
+}
+
+static bool AreHubLabelsCurrent(astar_grid *Grid)
+{
+    return Grid->HubLabels != NULL && Grid->HubLabels->Version == Grid->Version && Grid->Roads != NULL && Grid->Roads->Version == Grid->Version;
+}
+
+/*
+    Road distance between two cells in cells driven, or -1 when there is
+    no route. A cell joins the labels through the nodes at the ends of
+    its corridor. Falls back to a breadth-first search when the grid
+    has no labels or they are out of date.
+*/
+int RoadDistance(point From, point To, astar_grid *Grid)
+{
+    if (EqualPoints(From, To) && IsWalkable(From, Grid))
+        return 0;
+    if (!AreConnected(From, To, Grid))
+        return -1;
+
+    hub_labels *Labels = Grid->HubLabels;
+    road_graph *Roads = Grid->Roads;
+    if (!AreHubLabelsCurrent(Grid)) {
+        int CellsLength = Grid->NumberRows * Grid->NumberCols;
+        int *Distances = (int*) malloc(CellsLength * sizeof(int));
+        int *Queue = (int*) malloc(CellsLength * sizeof(int));
+        BreadthFirstDistances(Grid, From, Distances, Queue);
+        int Distance = Distances[To.Row * Grid->NumberCols + To.Col];
+        free(Queue);
+        free(Distances);
+        return Distance;
+    }
+
+    road_edge FromAnchors[4], ToAnchors[4];
+    int Best = -1, Unused = -1;
+    int FromAnchorsLength = AnchorRoadCell(Roads, Grid, From, To, FromAnchors, &Best);
+    int ToAnchorsLength = AnchorRoadCell(Roads, Grid, To, From, ToAnchors, &Unused);
+
+    for (int i = 0; i < FromAnchorsLength; i++) {
+        int a = FromAnchors[i].To;
+        for (int j = 0; j < ToAnchorsLength; j++) {
+            int b = ToAnchors[j].To;
+            int Between = MergeHubLabels(GetHubLabel(Labels, a), Labels->LabelLength[a], GetHubLabel(Labels, b), Labels->LabelLength[b]);
+            if (Between < 0)
+                continue;
+
+            int Distance = FromAnchors[i].Cost + Between + ToAnchors[j].Cost;
+            if (Best < 0 || Distance < Best)
+                Best = Distance;
+        }
+    }
+
+    return Best;
+}
+
+/*
+    The K Sources nearest to Goal by road, closest first, the same as 
+    FindNearestSources gives. With current labels each source costs one
+    RoadDistance, far less than a search out of Goal when the sources 
+    are few; without them it is that search.
+*/
+int FindNearestByRoad(point Goal, point *Sources, int SourcesLength, int K, astar_grid *Grid, astar_search *Search, int *Nearest, int *Distances)
+{
+    if (!AreHubLabelsCurrent(Grid))
+        return FindNearestSources(Goal, Sources, SourcesLength, K, Grid, Search, Nearest, Distances);
+
+    int Found = 0;
+    for (int i = 0; i < SourcesLength && K > 0; i++) {
+        int Distance = RoadDistance(Sources[i], Goal, Grid);
+        if (Distance < 0 || (Found == K && Distance >= Distances[K - 1]))
+            continue;
+
+        // insertion into the K best, behind the ones just as near
+        int j = Found < K ? Found++ : K - 1;
+        while (j > 0 && Distances[j - 1] > Distance) {
+            Nearest[j] = Nearest[j - 1];
+            Distances[j] = Distances[j - 1];
+            j--;
+        }
+        Nearest[j] = i;
+        Distances[j] = Distance;
+    }
+
+    return Found;
+}
@@ -0,0 +1,26 @@
+typedef struct hub_entry {
+	int Hub;
+	int Distance;
+} hub_entry;
+
+/*
+	2-hop distance labels over the road graph, taken from the upward
+	search spaces of the contraction hierarchy and pruned of every entry
+	that is not a shortest distance. Each label is sorted by Hub, so the
+	distance between two nodes is one merge of their labels.
+*/
+typedef struct hub_labels {
+	unsigned int Version;
+	int NodesLength;
+	int *LabelStart;
+	int *LabelLength;
+	hub_entry *Entries;
+	int EntriesLength, EntriesCapacity;
+	size_t Bytes;
+} hub_labels;
+
+hub_labels *		CreateHubLabels(astar_grid *Grid);
+void 				BuildHubLabels(hub_labels *Labels, astar_grid *Grid);
+void 				DestroyHubLabels(hub_labels *Labels);
+int 				RoadDistance(point From, point To, astar_grid *Grid);
+int 				FindNearestByRoad(point Goal, point *Sources, int SourcesLength, int K, astar_grid *Grid, astar_search *Search, int *Nearest, int *Distances);
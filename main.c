@@ -9,6 +9,7 @@
 #include <time.h>
 #include <stdbool.h>
 #include <sys/time.h>
+#include <pthread.h>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
@@ -28,6 +29,15 @@
 #include "nuklear_sdl_sdlrenderer.h"
 #include "overview.c"
 #include "aStar.c"
+#include "hpa.c"
+#include "roadGraph.c"
+#include "contraction.c"
+#include "hubLabels.c"
+#include "gridRebuild.c"
+#include "routeCache.c"
+#include "dStarLite.c"
+#include "cooperative.c"
+#include "planner.c"
 
 #define forever while(1)
 #define MS_PER_FRAME 16
@@ -40,7 +50,20 @@ const int TILE_SIZE_PIXELS = 16;
 const int MAX_NUMBER_OF_ROBOTAXIS = 20;
 const int MAX_NUMBER_OF_ORDERS = 100;
 const int MAX_NUMBER_OF_DEPOTS = 10;
+const int NUMBER_OF_PATH_WORKERS = 4;
+const search_mode PATH_SEARCH_MODE = SEARCH_MODE_HIERARCHICAL;
+const heuristic_type PATH_HEURISTIC = HEURISTIC_LANDMARKS;
+const int NUMBER_OF_LANDMARKS = 8;
+const int CLUSTER_SIZE = 10;
+const int ROUTE_CACHE_CAPACITY = 256;
+const int PATH_EXPANSION_BUDGET = 4000;
+const double PATH_WEIGHT = 1.5;
+const int ANYTIME_EXPANSION_BUDGET = 1000;
+const int DISPATCH_CANDIDATES = 3;
+const bool COOPERATIVE_ROUTING = true;
+const int RESERVATION_HORIZON = 16;
 const double ROBOTAXI_SPEED = 4;
+const int FRAMES_PER_TICK = TILE_SIZE_PIXELS / ROBOTAXI_SPEED; // the frames it takes to drive one cell
 int xMouse, yMouse;
 
 static struct {
@@ -64,7 +87,8 @@ typedef enum command_type {
 	ADD_ROBOTAXI,
 	ADD_ORDER,
 	ADD_DEPOT,
-	RETURN_TO_DEPOTS
+	RETURN_TO_DEPOTS,
+	TOGGLE_ROAD_CELL
 } command_type;
 
 typedef enum robotaxi_status {
@@ -74,7 +98,8 @@ typedef enum robotaxi_status {
 	ROBOTAXI_TO_ORDER,
 	ROBOTAXI_TO_DEST,
 	ROBOTAXI_END_SHIFT,
-	ROBOTAXI_TO_DEPOT
+	ROBOTAXI_TO_DEPOT,
+	ROBOTAXI_WAITING_FOR_ROUTE
 } robotaxi_status;
 
 typedef struct v2 {
@@ -112,7 +137,18 @@ typedef struct robotaxi {
 	double Speed;
 	order Order;
 	robotaxi_status Status;
-	Tstack *Path;
+	robotaxi_status NextStatus;
+	int RouteTicket;
+	Tpath *Path;
+	Tpath *Route;
+	Tpath *PlannedPath;
+	Tpath *PlannedRoute;
+	bool RoutePlanned;
+	dstar_search *Replanner;
+	astar_search *RouteSearch;
+	Tpath *Steps;
+	unsigned int StepsTick;
+	point StepsGoal;
 	struct robotaxi_dispatcher *Dispatcher;
 	v2 NextPosition;
 } robotaxi;
@@ -125,6 +161,12 @@ typedef struct robotaxi_dispatcher {
 	Tqueue Orders;
 	robotaxi *Robotaxis;
 	depot *Depots;
+	distance_field *DepotField;
+	astar_search *Search;
+	reservation_table *Reservations;
+	cooperative_search *CooperativeSearch;
+	path_planner *Planner;
+	unsigned int Frame;
 	int RobotaxisLength;
 	int OrdersLength;
 	int DepotsLength;
@@ -133,6 +175,8 @@ typedef struct robotaxi_dispatcher {
 typedef struct game_state {
 	tilemap Tilemap;
 	astar_grid *AStarGrid;
+	grid_rebuild *Rebuild;
+	path_planner *Planner;
 	robotaxi_dispatcher *Dispatcher;
 	Tqueue Commands;
 } game_state;
@@ -140,21 +184,36 @@ typedef struct game_state {
 void CreateWindow(int Width, int Height);
 game_state * CreateGameState();
 astar_grid * CreateAStarGrid();
-robotaxi_dispatcher * CreateDispatcher();
+void RefreshAStarGrid(astar_grid *AStarGrid, grid_rebuild *Rebuild);
+robotaxi_dispatcher * CreateDispatcher(path_planner *Planner);
 void CreateOrder(Tqueue *Orders, int *OrdersLength, astar_grid *AStarGrid);
 void CreateDepot(depot *Depots, int *DepotsLength);
+void SetRoadCellOpen(game_state *GameState, point Location, bool Open);
+void ToggleRoadCell(game_state *GameState);
+void RepairRobotaxiPaths(robotaxi_dispatcher *Dispatcher, astar_grid *AStarGrid, point Changed);
 
 void HandleInput(game_state *GameState);
 void UpdateAndRenderPlay(game_state *GameState);
 void Update(game_state *GameState);
 void UpdateDispatcher(robotaxi_dispatcher *Dispatcher, astar_grid *AStarGrid);
+void RefreshDepotField(robotaxi_dispatcher *Dispatcher, astar_grid *AStarGrid);
 void DispatcherRemoveOrder(robotaxi_dispatcher *Dispatcher, order Order);
+void RobotaxiTakeNearestOrder(robotaxi *Robotaxi, robotaxi_dispatcher *Dispatcher, astar_grid *AStarGrid);
 void UpdateOrder(order *Order);
-void UpdateRobotaxi(robotaxi *robotaxi, astar_grid *AStarGrid, depot *Depots, int DepotsLength);
-void UpdateRobotaxis(robotaxi *robotaxis, int RobotaxisLength, astar_grid *AStarGrid, depot *Depots, int DepotsLength);
-void RobotaxiFollowPath(robotaxi *robotaxi, Tstack *Path, point LastPosition);
+void PlanRobotaxiRoutes(robotaxi_dispatcher *Dispatcher, astar_grid *AStarGrid, path_planner *Planner);
+void RobotaxiRouteReady(path_request *Request, void *Dispatcher);
+void RobotaxiLegReady(path_request *Request, void *Dispatcher);
+bool RobotaxiNeedsRoute(robotaxi *Robotaxi, astar_grid *AStarGrid, point *Start, point *End);
+Tpath * RobotaxiTakePlannedPath(robotaxi *Robotaxi);
+void RobotaxiEndTrip(robotaxi *Robotaxi);
+void UpdateRobotaxi(robotaxi *robotaxi, astar_grid *AStarGrid, distance_field *DepotField);
+void UpdateRobotaxis(robotaxi *robotaxis, int RobotaxisLength, astar_grid *AStarGrid, distance_field *DepotField);
+void RobotaxiFollowPath(robotaxi *robotaxi, Tpath *Path, point LastPosition);
+void RobotaxiDrive(robotaxi *Robotaxi, point LastPosition, astar_grid *AStarGrid);
+bool RobotaxiFollowSteps(robotaxi *Robotaxi, point LastPosition, astar_grid *AStarGrid);
+void TickReservations(robotaxi_dispatcher *Dispatcher, astar_grid *AStarGrid);
+bool RobotaxiFollowField(robotaxi *Robotaxi, distance_field *Field, astar_grid *AStarGrid);
 void RobotaxisReturnToDepots(robotaxi *robotaxis, int RobotaxisLength);
-v2 FindClosestDepot(v2 RobotaxiPosition, depot *Depots, int DepotsLength);
 
 void Draw(game_state *GameState);
 void StartDrawing();
@@ -166,7 +225,7 @@ void DrawOrder(order *Order);
 void DrawOrders(Tqueue *Orders);
 void Drawrobotaxi(robotaxi *robotaxi);
 void DrawRobotaxis(robotaxi *robotaxis, int RobotaxisLength);
-void DrawPath(Tstack **Path);
+void DrawPath(Tpath *Path);
 
 void AddRobotaxi(robotaxi *robotaxi, int *RobotaxisLength, depot *Depots, int DepotsLength);
 void AssignOrderToRobotaxi(robotaxi *robotaxi, order Order);
@@ -229,6 +288,12 @@ game_state * CreateGameState()
 	GameState->Tilemap.Height = SCREEN_HEIGHT_PIXELS / TILE_SIZE_PIXELS;
 	GameState->Tilemap.Tiles = (tile *) calloc(GameState->Tilemap.Width * GameState->Tilemap.Height, sizeof(tile));
 	GameState->AStarGrid = CreateAStarGrid();
+	GameState->Rebuild = CreateGridRebuild(GameState->AStarGrid);
+	GameState->Planner = CreatePathPlanner(GameState->AStarGrid, NUMBER_OF_PATH_WORKERS, ROUTE_CACHE_CAPACITY);
+	SetPathPlannerMode(GameState->Planner, PATH_SEARCH_MODE);
+	SetPathPlannerHeuristic(GameState->Planner, PATH_HEURISTIC);
+	SetPathPlannerBudget(GameState->Planner, PATH_EXPANSION_BUDGET);
+	SetPathPlannerWeight(GameState->Planner, PATH_WEIGHT, ANYTIME_EXPANSION_BUDGET);
 
 	int k = 0;
 	for (int i = 0; i < GameState->AStarGrid->NumberRows; i++) {
@@ -237,7 +302,7 @@ game_state * CreateGameState()
 		}
 	}
 
-	GameState->Dispatcher = CreateDispatcher();
+	GameState->Dispatcher = CreateDispatcher(GameState->Planner);
 	InitQueue(&GameState->Commands, sizeof(command_type), NULL);
 
 	return GameState;
@@ -249,6 +314,7 @@ astar_grid * CreateAStarGrid()
 	AStarGrid->NumberRows = SCREEN_HEIGHT_PIXELS / TILE_SIZE_PIXELS;
 	AStarGrid->NumberCols = SCREEN_WIDTH_PIXELS / TILE_SIZE_PIXELS;
 	AStarGrid->IsOpenCellFunction = IsOpenCellFunction;
+	AStarGrid->Version = 0;
 	AStarGrid->Map = (cell**) malloc(AStarGrid->NumberRows * sizeof(cell*));
 
 	for (int i = 0; i < AStarGrid->NumberRows; i++) {
@@ -264,28 +330,63 @@ astar_grid * CreateAStarGrid()
 				AStarGrid->Map[i][j].MovementCost = 1;
 			}
 			
-			AStarGrid->Map[i][j].Location.Row = 0;
-			AStarGrid->Map[i][j].Location.Col = 0;
-			AStarGrid->Map[i][j].f = -1;
-			AStarGrid->Map[i][j].g = 0.0;
-            AStarGrid->Map[i][j].h = 0.0;
+			AStarGrid->Map[i][j].Location.Row = i;
+			AStarGrid->Map[i][j].Location.Col = j;
 		}
 	}
 
+	AStarGrid->Passability = CreatePassability(AStarGrid);
+	AStarGrid->Components = CreateComponents(AStarGrid);
+	AStarGrid->Landmarks = CreateLandmarks(AStarGrid, NUMBER_OF_LANDMARKS);
+	AStarGrid->Hierarchy = CreateHierarchy(AStarGrid, CLUSTER_SIZE);
+	AStarGrid->Roads = CreateRoadGraph(AStarGrid);
+	DEBUG_PRINTL("Road graph: %d nodes, %d edges for %d open cells\n", AStarGrid->Roads->NodesLength, 
+				 AStarGrid->Roads->EdgesLength, AStarGrid->Roads->OpenCellsLength);
+	// the dispatcher ranks taxis by hub label distances, which are built on the contraction
+	AStarGrid->Contraction = CreateContraction(AStarGrid);
+	AStarGrid->HubLabels = CreateHubLabels(AStarGrid);
+	DEBUG_PRINTL("Hub labels: %d entries, %zu bytes\n", AStarGrid->HubLabels->EntriesLength, AStarGrid->HubLabels->Bytes);
+
 	return AStarGrid;
 }
 
-robotaxi_dispatcher * CreateDispatcher()
+/*
+	Keeps the tables derived from the map in step with MovementCost edits
+	(SetCellMovementCost), which move the grid to a new Version. The 
+	connected components are cheap and rebuilt here; everything else is
+	rebuilt by the grid_rebuild thread and swapped in on the first frame
+	after it is done. Called while the planner is paused for edits.
+*/
+void RefreshAStarGrid(astar_grid *AStarGrid, grid_rebuild *Rebuild)
+{
+	if (AStarGrid->Components->Version != AStarGrid->Version) {
+		BuildComponents(AStarGrid->Components, AStarGrid);
+	}
+
+	FinishGridRebuild(Rebuild, AStarGrid);
+	if (IsGridStale(AStarGrid)) {
+		StartGridRebuild(Rebuild, AStarGrid);
+	}
+}
+
+robotaxi_dispatcher * CreateDispatcher(path_planner *Planner)
 {
 	robotaxi_dispatcher *Dispatcher = (robotaxi_dispatcher *) malloc(sizeof(robotaxi_dispatcher));
 	Dispatcher->Robotaxis = (robotaxi *) malloc (MAX_NUMBER_OF_ROBOTAXIS * sizeof(robotaxi));
 	for (int i = 0; i < MAX_NUMBER_OF_ROBOTAXIS; ++i) {
 		Dispatcher->Robotaxis[i].Speed = ROBOTAXI_SPEED;
+		Dispatcher->Robotaxis[i].Dispatcher = Dispatcher;
 	}
 
 	Dispatcher->RobotaxisLength = 0;
 	Dispatcher->Depots = (depot *) malloc(MAX_NUMBER_OF_DEPOTS * sizeof(depot));
 	Dispatcher->DepotsLength = 0;
+	Dispatcher->DepotField = NULL;
+	Dispatcher->Search = NULL;
+	Dispatcher->Reservations = NULL;
+	Dispatcher->CooperativeSearch = NULL;
+	Dispatcher->Planner = Planner;
+	Dispatcher->Frame = 0;
 
 	// init orders
 	InitQueue(&Dispatcher->Orders, sizeof(order), NULL);
@@ -312,6 +413,82 @@ void CreateDepot(depot *Depots, int *DepotsLength)
 	(*DepotsLength)++;
 }
 
+/*
+	Closes or reopens a road cell at runtime. Taxis whose remaining Path
+	runs through it are repaired right away by RepairRobotaxiPaths.
+*/
+void SetRoadCellOpen(game_state *GameState, point Location, bool Open)
+{
+	astar_grid *AStarGrid = GameState->AStarGrid;
+	if (Location.Row < 0 || Location.Row >= AStarGrid->NumberRows || Location.Col < 0 || Location.Col >= AStarGrid->NumberCols)
+		return;
+
+	if (IsOpenCellFunction(Location, AStarGrid) == Open)
+		return;
+
+	SetCellMovementCost(AStarGrid, Location, Open ? 1 : 0);
+	GameState->Tilemap.Tiles[Location.Row * AStarGrid->NumberCols + Location.Col].Type = Open ? ROAD_TILE : TOWER_TILE;
+	RepairRobotaxiPaths(GameState->Dispatcher, AStarGrid, Location);
+}
+
+void ToggleRoadCell(game_state *GameState)
+{
+	point Location = {abs(yMouse - SCREEN_HEIGHT_PIXELS) / TILE_SIZE_PIXELS, xMouse / TILE_SIZE_PIXELS};
+	if (Location.Row >= GameState->AStarGrid->NumberRows)
+		return;
+
+	SetRoadCellOpen(GameState, Location, !IsOpenCellFunction(Location, GameState->AStarGrid));
+}
+
+/*
+	Every taxi keeps a D* Lite search towards the end of its current 
+	route once it had to be repaired. While that search has seen every 
+	edit it is only told about the changed cell; otherwise taxis whose 
+	Path crosses the cell start a new one. A repaired Path runs to the 
+	final goal, so a hierarchical Route still waiting to be refined is
+	dropped. A taxi whose current segment is cut turns around in the 
+	cell it is in.
+*/
+void RepairRobotaxiPaths(robotaxi_dispatcher *Dispatcher, astar_grid *AStarGrid, point Changed)
+{
+	for (int i = 0; i < Dispatcher->RobotaxisLength; i++) {
+		robotaxi *Robotaxi = &Dispatcher->Robotaxis[i];
+		if (IsPathEmpty(Robotaxi->Path))
+			continue;
+
+		point Here = {(int) (Robotaxi->Position.X / TILE_SIZE_PIXELS), (int) (Robotaxi->Position.Y / TILE_SIZE_PIXELS)};
+		point Start = {(int) (Robotaxi->NextPosition.X / TILE_SIZE_PIXELS), (int) (Robotaxi->NextPosition.Y / TILE_SIZE_PIXELS)};
+		bool SegmentCut = IsOnSegment(Here, Start, Changed) && !EqualPoints(Here, Changed);
+		if (SegmentCut)
+			Start = Here;
+
+		point Goal = IsRouteRefined(Robotaxi->Route) ? GetPathPoint(Robotaxi->Path, Robotaxi->Path->Length - 1) 
+													 : GetPathPoint(Robotaxi->Route, Robotaxi->Route->Length - 1);
+		Tpath *Repaired = NULL;
+		if (DStarIsTracking(Robotaxi->Replanner, Goal, AStarGrid)) {
+			DStarUpdateCell(Robotaxi->Replanner, Changed, AStarGrid);
+			Repaired = DStarReplan(Robotaxi->Replanner, Start, AStarGrid);
+		} else if (SegmentCut || PathContains(Robotaxi->Path, Changed)) {
+			if (Robotaxi->Replanner == NULL)
+				Robotaxi->Replanner = CreateDStarSearch(AStarGrid);
+			Repaired = DStarFindPath(Robotaxi->Replanner, Start, Goal, AStarGrid);
+		} else {
+			continue;
+		}
+
+		if (Repaired == NULL) {
+			DEBUG_PRINTL("Robotaxi %d has no way around (%d %d)\n", i, Changed.Row, Changed.Col);
+			continue;
+		}
+
+		DestroyPath(&Robotaxi->Path);
+		DestroyPath(&Robotaxi->Route);
+		Robotaxi->Path = Repaired;
+		if (SegmentCut)
+			Robotaxi->NextPosition = (v2) {Here.Row * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS/2, Here.Col * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS/2};
+	}
+}
+
 void UpdateAndRenderPlay(game_state *GameState)
 {
 	forever {
@@ -349,6 +526,11 @@ void HandleInput(game_state *GameState)
 					case SDLK_d:
 			    		PushQueue(&GameState->Commands, &(command_type){RETURN_TO_DEPOTS});
 					    break;
+
+					case SDLK_c:
+			    		PushQueue(&GameState->Commands, &(command_type){TOGGLE_ROAD_CELL});
+			    		SDL_GetMouseState(&xMouse, &yMouse);
+					    break;
 	    		}
 	    	} break;
 
@@ -367,6 +549,7 @@ void HandleInput(game_state *GameState)
 
 void Update(game_state *GameState)
 {	
+	BeginGridEdit(GameState->Planner);
 	while (!IsQueueEmpty(&GameState->Commands)) {
 		command_type Command;
 		PeekQueue(&GameState->Commands, &Command);
@@ -385,6 +568,11 @@ void Update(game_state *GameState)
 
 			case ADD_DEPOT:
 				CreateDepot(GameState->Dispatcher->Depots, &GameState->Dispatcher->DepotsLength);
+				RefreshDepotField(GameState->Dispatcher, GameState->AStarGrid);
+				break;
+
+			case TOGGLE_ROAD_CELL:
+				ToggleRoadCell(GameState);
 				break;
 
 			case RETURN_TO_DEPOTS:
@@ -397,9 +585,15 @@ void Update(game_state *GameState)
 		PopQueue(&GameState->Commands);
 	}
 
+	RefreshAStarGrid(GameState->AStarGrid, GameState->Rebuild);
+	RefreshDepotField(GameState->Dispatcher, GameState->AStarGrid);
+	EndGridEdit(GameState->Planner);
+
 	UpdateDispatcher(GameState->Dispatcher, GameState->AStarGrid);
+	PlanRobotaxiRoutes(GameState->Dispatcher, GameState->AStarGrid, GameState->Planner);
+	TickReservations(GameState->Dispatcher, GameState->AStarGrid);
 	UpdateRobotaxis(GameState->Dispatcher->Robotaxis, GameState->Dispatcher->RobotaxisLength, GameState->AStarGrid,
-					GameState->Dispatcher->Depots, GameState->Dispatcher->DepotsLength);
+					GameState->Dispatcher->DepotField);
 }
 
 void Draw(game_state *GameState)
@@ -417,42 +611,279 @@ void Draw(game_state *GameState)
 	EndDrawing();
 }
 
+/*
+	Keeps one distance field from all depots at once, rebuilt when a 
+	depot is added or the map changed since it was built. Returning taxis
+	read their way to the nearest depot off it.
+*/
+void RefreshDepotField(robotaxi_dispatcher *Dispatcher, astar_grid *AStarGrid)
+{
+	if (Dispatcher->DepotField == NULL)
+		Dispatcher->DepotField = CreateDistanceField(AStarGrid);
+
+	distance_field *Field = Dispatcher->DepotField;
+	if (Field->Version == AStarGrid->Version && Field->SourcesLength == Dispatcher->DepotsLength)
+		return;
+
+	point Sources[MAX_NUMBER_OF_DEPOTS];
+	for (int i = 0; i < Dispatcher->DepotsLength; i++) {
+		Sources[i] = (point) {(int) (Dispatcher->Depots[i].Position.X / TILE_SIZE_PIXELS), (int) (Dispatcher->Depots[i].Position.Y / TILE_SIZE_PIXELS)};
+	}
+
+	BuildDistanceField(Field, AStarGrid, Sources, Dispatcher->DepotsLength);
+}
+
+/*
+	A taxi that just dropped a passenger off takes the waiting order 
+	nearest to it by road, found together with its route by a single
+	FindPathToAny. The orders left are then handed out from the front
+	of the queue, each to the available taxi nearest to the order's
+	parking spot by road, ranked on the hub labels (FindNearestByRoad).
+*/
 void UpdateDispatcher(robotaxi_dispatcher *Dispatcher, astar_grid *AStarGrid) 
 {	
-	if (IsQueueEmpty(&Dispatcher->Orders)) {
-		return;
+	if (Dispatcher->Search == NULL)
+		Dispatcher->Search = CreateAStarSearch(AStarGrid);
+
+	for (int i = 0; i < Dispatcher->RobotaxisLength && !IsQueueEmpty(&Dispatcher->Orders); i++) {
+		robotaxi *Robotaxi = &Dispatcher->Robotaxis[i];
+		if (Robotaxi->Status == ROBOTAXI_AVAILABLE && Robotaxi->Order.Status == ARRIVED && Robotaxi->RouteTicket < 0)
+			RobotaxiTakeNearestOrder(Robotaxi, Dispatcher, AStarGrid);
 	}
 
-	for (int i = 0; i < Dispatcher->RobotaxisLength; i++) {
-		if (IsQueueEmpty(&Dispatcher->Orders)) {
-			break;
+	// an order no free taxi can reach stays queued without holding up the ones behind it
+	node *Next = NULL;
+	for (node *Temp = Dispatcher->Orders.head; Temp != NULL; Temp = Next) {
+		Next = Temp->next;
+		order aux = *((order*) Temp->Data);
+		point ParkingSpot = FindParkingSpot(aux.Position, AStarGrid);
+
+		point Positions[MAX_NUMBER_OF_ROBOTAXIS];
+		int Available[MAX_NUMBER_OF_ROBOTAXIS];
+		int AvailableLength = 0;
+		for (int i = 0; i < Dispatcher->RobotaxisLength; i++) {
+			if (Dispatcher->Robotaxis[i].Status != ROBOTAXI_AVAILABLE)
+				continue;
+
+			Positions[AvailableLength] = (point) {(int) (Dispatcher->Robotaxis[i].Position.X / TILE_SIZE_PIXELS), (int) (Dispatcher->Robotaxis[i].Position.Y / TILE_SIZE_PIXELS)};
+			Available[AvailableLength++] = i;
 		}
 
-		if (Dispatcher->Robotaxis[i].Status == ROBOTAXI_AVAILABLE) {
-			order aux = {};
-			PeekQueue(&Dispatcher->Orders, &aux);
-			PopQueue(&Dispatcher->Orders);
-			AssignOrderToRobotaxi(&Dispatcher->Robotaxis[i], aux);
-			Dispatcher->OrdersLength--;
+		if (AvailableLength == 0)
+			break;
+
+		int Nearest[DISPATCH_CANDIDATES], Distances[DISPATCH_CANDIDATES];
+		int Found = FindNearestByRoad(ParkingSpot, Positions, AvailableLength, DISPATCH_CANDIDATES, AStarGrid, Dispatcher->Search, Nearest, Distances);
+		if (Found == 0)
+			continue;
+
+		for (int i = 0; i < Found; i++) {
+			DEBUG_PRINTL("Candidate %d for the order: taxi %d, %d cells away", i, Available[Nearest[i]], Distances[i]);
 		}
+
+		DispatcherRemoveOrder(Dispatcher, aux);
+		AssignOrderToRobotaxi(&Dispatcher->Robotaxis[Available[Nearest[0]]], aux);
+	}
+}
+
+void RobotaxiTakeNearestOrder(robotaxi *Robotaxi, robotaxi_dispatcher *Dispatcher, astar_grid *AStarGrid)
+{
+	point ParkingSpots[MAX_NUMBER_OF_ORDERS];
+	order Orders[MAX_NUMBER_OF_ORDERS];
+	int OrdersLength = 0;
+	for (node *Temp = Dispatcher->Orders.head; Temp != NULL && OrdersLength < MAX_NUMBER_OF_ORDERS; Temp = Temp->next) {
+		Orders[OrdersLength] = *((order*) Temp->Data);
+		ParkingSpots[OrdersLength] = FindParkingSpot(Orders[OrdersLength].Position, AStarGrid);
+		OrdersLength++;
+	}
+
+	point Start = {(int) (Robotaxi->Position.X / TILE_SIZE_PIXELS), (int) (Robotaxi->Position.Y / TILE_SIZE_PIXELS)};
+	int Reached = -1;
+	Tpath *Path = FindPathToAny(Start, ParkingSpots, OrdersLength, AStarGrid, Dispatcher->Search, &Reached);
+	if (Path == NULL)
+		return;
+
+	DispatcherRemoveOrder(Dispatcher, Orders[Reached]);
+	AssignOrderToRobotaxi(Robotaxi, Orders[Reached]);
+
+	// the route to the order came with the search, no need to plan it again
+	Robotaxi->PlannedPath = Path;
+	Robotaxi->PlannedRoute = NULL;
+	Robotaxi->RoutePlanned = true;
+	Robotaxi->NextStatus = ROBOTAXI_TO_ORDER;
+	Robotaxi->Status = ROBOTAXI_WAITING_FOR_ROUTE;
+}
+
+void DispatcherRemoveOrder(robotaxi_dispatcher *Dispatcher, order Order)
+{
+	node **Link = &Dispatcher->Orders.head;
+	while (*Link != NULL) {
+		order *Queued = (order*) (*Link)->Data;
+		if (Queued->Position.X == Order.Position.X && Queued->Position.Y == Order.Position.Y &&
+			Queued->Destination.X == Order.Destination.X && Queued->Destination.Y == Order.Destination.Y)
+			break;
+		Link = &(*Link)->next;
 	}
+
+	if (*Link == NULL)
+		return;
+
+	node *Temp = *Link;
+	*Link = Temp->next;
+	free(Temp->Data);
+	free(Temp);
+	Dispatcher->OrdersLength--;
 }
 
 void AssignOrderToRobotaxi(robotaxi *Robotaxi, order Order)
 {
+	RobotaxiEndTrip(Robotaxi);
 	Robotaxi->Order = Order;
 	Robotaxi->Order.Status = WAITING;
 	Robotaxi->Status = ROBOTAXI_RECEIVED_ORDER;
 }
 
-void UpdateRobotaxis(robotaxi *Robotaxis, int RobotaxisLength, astar_grid *AStarGrid, depot *Depots, int DepotsLength) 
+/*
+	Hands the routes the workers finished since the last tick to their
+	taxis and submits a job for every taxi that needs a route, without
+	waiting for it: the taxi stays ROBOTAXI_WAITING_FOR_ROUTE until its
+	PlannedPath arrives. Taxis driving a hierarchical Route lend it to a
+	job that brings back the next leg before their Path runs out. All 
+	the jobs share PATH_EXPANSION_BUDGET expansions per frame.
+*/
+void PlanRobotaxiRoutes(robotaxi_dispatcher *Dispatcher, astar_grid *AStarGrid, path_planner *Planner)
+{
+	RefillPathBudget(Planner);
+	DispatchFinishedPaths(Planner);
+
+	for (int i = 0; i < Dispatcher->RobotaxisLength; i++) {
+		robotaxi *Robotaxi = &Dispatcher->Robotaxis[i];
+		if (Robotaxi->RouteTicket >= 0)
+			continue;
+
+		if (PATH_EXPANSION_BUDGET > 0 && Robotaxi->RouteSearch == NULL)
+			Robotaxi->RouteSearch = CreateAStarSearch(AStarGrid);
+
+		path_request Request = {0};
+		Request.Id = i;
+		Request.Resume = Robotaxi->RouteSearch;
+		if (RobotaxiNeedsRoute(Robotaxi, AStarGrid, &Request.Start, &Request.End)) {
+			Robotaxi->NextStatus = Robotaxi->Status == ROBOTAXI_RECEIVED_ORDER ? ROBOTAXI_TO_ORDER : ROBOTAXI_TO_DEST;
+			Robotaxi->Status = ROBOTAXI_WAITING_FOR_ROUTE;
+			Robotaxi->RouteTicket = SubmitPathRequest(Planner, &Request, RobotaxiRouteReady, Dispatcher);
+		} else if (!IsRouteRefined(Robotaxi->Route) && PathLength(Robotaxi->Path) <= 1) {
+			Request.Route = Robotaxi->Route;
+			Robotaxi->Route = NULL;
+			Robotaxi->RouteTicket = SubmitPathRequest(Planner, &Request, RobotaxiLegReady, Dispatcher);
+		}
+	}
+}
+
+void RobotaxiRouteReady(path_request *Request, void *Dispatcher)
+{
+	robotaxi *Robotaxi = &((robotaxi_dispatcher*) Dispatcher)->Robotaxis[Request->Id];
+	Robotaxi->RouteTicket = -1;
+
+	if (Robotaxi->Status != ROBOTAXI_WAITING_FOR_ROUTE) {
+		DestroyPath(&Request->Path);
+		DestroyPath(&Request->Route);
+		return;
+	}
+
+	Robotaxi->PlannedPath = Request->Path;
+	Robotaxi->PlannedRoute = Request->Route;
+	Robotaxi->RoutePlanned = true;
+}
+
+void RobotaxiLegReady(path_request *Request, void *Dispatcher)
+{
+	robotaxi *Robotaxi = &((robotaxi_dispatcher*) Dispatcher)->Robotaxis[Request->Id];
+	Robotaxi->RouteTicket = -1;
+
+	if (Robotaxi->Status != ROBOTAXI_TO_ORDER && Robotaxi->Status != ROBOTAXI_TO_DEST) {
+		DestroyPath(&Request->Path);
+		DestroyPath(&Request->Route);
+		return;
+	}
+
+	Robotaxi->Route = Request->Route;
+	if (Request->Path == NULL || IsRouteRefined(Robotaxi->Route))
+		DestroyPath(&Robotaxi->Route);
+	AppendPath(&Robotaxi->Path, Request->Path);
+}
+
+bool RobotaxiNeedsRoute(robotaxi *Robotaxi, astar_grid *AStarGrid, point *Start, point *End)
+{
+	if (Robotaxi->RoutePlanned)
+		return false;
+
+	*Start = (point) {(int) (Robotaxi->Position.X / TILE_SIZE_PIXELS),(int) (Robotaxi->Position.Y / TILE_SIZE_PIXELS)};
+
+	switch (Robotaxi->Status) {
+		case ROBOTAXI_RECEIVED_ORDER:
+		{
+			*End = FindParkingSpot(Robotaxi->Order.Position, AStarGrid);
+			return true;
+		}
+
+		case ROBOTAXI_TO_ORDER:
+		{
+			point LastPosition = FindParkingSpot(Robotaxi->Order.Position, AStarGrid);
+			if (IsPathEmpty(Robotaxi->Path) && 
+				RobotaxiFinishedFollowPath(Robotaxi->Position, LastPosition)) {
+				*End = FindParkingSpot(Robotaxi->Order.Destination, AStarGrid);
+				return true;
+			}
+		} break;
+
+		default:
+			break;
+	}
+
+	return false;
+}
+
+Tpath * RobotaxiTakePlannedPath(robotaxi *Robotaxi)
+{
+	Tpath *Path = Robotaxi->PlannedPath;
+	Robotaxi->PlannedPath = NULL;
+	Robotaxi->RoutePlanned = false;
+
+	DestroyPath(&Robotaxi->Route);
+	Robotaxi->Route = Robotaxi->PlannedRoute;
+	Robotaxi->PlannedRoute = NULL;
+	if (IsRouteRefined(Robotaxi->Route))
+		DestroyPath(&Robotaxi->Route);
+	return Path;
+}
+
+/*
+	Drops everything planned for the trip the taxi was on. A job still
+	out for it is cancelled, so neither its route nor a leg of it can 
+	land on the next trip.
+*/
+void RobotaxiEndTrip(robotaxi *Robotaxi)
+{
+	if (Robotaxi->RouteTicket >= 0) {
+		CancelPathRequest(Robotaxi->Dispatcher->Planner, Robotaxi->RouteTicket);
+		Robotaxi->RouteTicket = -1;
+	}
+
+	DestroyPath(&Robotaxi->Path);
+	DestroyPath(&Robotaxi->Route);
+	DestroyPath(&Robotaxi->PlannedPath);
+	DestroyPath(&Robotaxi->PlannedRoute);
+	Robotaxi->RoutePlanned = false;
+}
+
+void UpdateRobotaxis(robotaxi *Robotaxis, int RobotaxisLength, astar_grid *AStarGrid, distance_field *DepotField) 
 {
 	for (int i = 0; i < RobotaxisLength; i++) {
-		UpdateRobotaxi(&Robotaxis[i], AStarGrid, Depots, DepotsLength);
+		UpdateRobotaxi(&Robotaxis[i], AStarGrid, DepotField);
 	}
 }
 
-void UpdateRobotaxi(robotaxi *Robotaxi, astar_grid *AStarGrid, depot *Depots, int DepotsLength)
+void UpdateRobotaxi(robotaxi *Robotaxi, astar_grid *AStarGrid, distance_field *DepotField)
 {	
 	if (!Robotaxi) return;
 
@@ -461,44 +892,39 @@ void UpdateRobotaxi(robotaxi *Robotaxi, astar_grid *AStarGrid, depot *Depots, in
 			break;
 
 		case ROBOTAXI_RECEIVED_ORDER:
+			break;
+
+		case ROBOTAXI_WAITING_FOR_ROUTE:
 		{
-			Robotaxi->Path = FindPath(
-								(point) {(int) (Robotaxi->Position.X / TILE_SIZE_PIXELS),(int) (Robotaxi->Position.Y / TILE_SIZE_PIXELS)}, 
-								FindParkingSpot(Robotaxi->Order.Position, AStarGrid), AStarGrid
-							);
-			if (Robotaxi->Path != NULL) {
-				Robotaxi->Status = ROBOTAXI_TO_ORDER;
-			} else {
+			if (!Robotaxi->RoutePlanned)
+				break;
+
+			DestroyPath(&Robotaxi->Path);
+			Robotaxi->Path = RobotaxiTakePlannedPath(Robotaxi);
+			if (Robotaxi->Path == NULL) {
+				RobotaxiEndTrip(Robotaxi);
 				Robotaxi->Status = ROBOTAXI_AVAILABLE;
+				break;
 			}
+
+			Robotaxi->Status = Robotaxi->NextStatus;
+			if (Robotaxi->Status == ROBOTAXI_TO_DEST)
+				Robotaxi->Order.Status = IN_TRANSIT;
 		} break;
 
 		case ROBOTAXI_TO_ORDER:
 		{	
 			point LastPosition = FindParkingSpot(Robotaxi->Order.Position, AStarGrid);
-			RobotaxiFollowPath(Robotaxi, Robotaxi->Path, LastPosition);
-
-			if ((!Robotaxi->Path || IsStackEmpty(Robotaxi->Path)) && 
-				RobotaxiFinishedFollowPath(Robotaxi->Position, LastPosition)) {
-				Robotaxi->Path = FindPath(
-									(point) {(int) (Robotaxi->Position.X / TILE_SIZE_PIXELS),(int) (Robotaxi->Position.Y / TILE_SIZE_PIXELS)}, 
-									FindParkingSpot(Robotaxi->Order.Destination, AStarGrid), AStarGrid
-								);		
-				if (Robotaxi->Path != NULL) {
-					Robotaxi->Status = ROBOTAXI_TO_DEST;
-					Robotaxi->Order.Status = IN_TRANSIT;
-				} else {
-					Robotaxi->Status = ROBOTAXI_AVAILABLE;
-				}
-			}
+			RobotaxiDrive(Robotaxi, LastPosition, AStarGrid);
 		} break;
 
 		case ROBOTAXI_TO_DEST:
 		{
 			point LastPosition = FindParkingSpot(Robotaxi->Order.Destination, AStarGrid);
-			RobotaxiFollowPath(Robotaxi, Robotaxi->Path, LastPosition);
+			RobotaxiDrive(Robotaxi, LastPosition, AStarGrid);
 
-			if ((!Robotaxi->Path || IsStackEmpty(Robotaxi->Path)) && RobotaxiFinishedFollowPath(Robotaxi->Position, LastPosition)) {
+			if (IsPathEmpty(Robotaxi->Path) && RobotaxiFinishedFollowPath(Robotaxi->Position, LastPosition)) {
+				RobotaxiEndTrip(Robotaxi);
 				Robotaxi->Status = ROBOTAXI_AVAILABLE;
 				Robotaxi->Order.Status = ARRIVED;
 			}
@@ -506,13 +932,8 @@ void UpdateRobotaxi(robotaxi *Robotaxi, astar_grid *AStarGrid, depot *Depots, in
 
 		case ROBOTAXI_END_SHIFT:
 		{	
-			v2 ClosestDepot = FindClosestDepot(Robotaxi->Position, Depots, DepotsLength);
-			if ((!Robotaxi->Path || IsStackEmpty(Robotaxi->Path))) {
-				Robotaxi->Path = FindPath(
-									(point) {(int) (Robotaxi->Position.X / TILE_SIZE_PIXELS),(int) (Robotaxi->Position.Y / TILE_SIZE_PIXELS)}, 
-									(point) {(int) (ClosestDepot.X / TILE_SIZE_PIXELS), (int) (ClosestDepot.Y / TILE_SIZE_PIXELS)},
-									 AStarGrid
-								);	
+			if (IsPathEmpty(Robotaxi->Path)) {
+				RobotaxiEndTrip(Robotaxi);
 				Robotaxi->Status = ROBOTAXI_TO_DEPOT;
 			}
 
@@ -520,29 +941,151 @@ void UpdateRobotaxi(robotaxi *Robotaxi, astar_grid *AStarGrid, depot *Depots, in
 
 		case ROBOTAXI_TO_DEPOT:
 		{
-			v2 ClosestDepot = FindClosestDepot(Robotaxi->Position, Depots, DepotsLength);
-			if (RobotaxiFinishedFollowPath(Robotaxi->Position, (point) {(int) (ClosestDepot.X / TILE_SIZE_PIXELS), (int) (ClosestDepot.Y / TILE_SIZE_PIXELS)}) == 0) {
-				RobotaxiFollowPath(Robotaxi, Robotaxi->Path, (point) {(int) (ClosestDepot.X / TILE_SIZE_PIXELS), (int) (ClosestDepot.Y / TILE_SIZE_PIXELS)});
-			} else {
+			if (!RobotaxiFollowField(Robotaxi, DepotField, AStarGrid)) {
 				Robotaxi->Status = ROBOTAXI_AVAILABLE;
 			}
 		} break;
 	}
 }
 
-void RobotaxiFollowPath(robotaxi *Robotaxi, Tstack *Path, point LastPosition)
+/*
+	NextPosition is the next corner of the path: the taxi drives along 
+	the segment until it gets there and only then pops the next one.
+*/
+void RobotaxiFollowPath(robotaxi *Robotaxi, Tpath *Path, point LastPosition)
 {
-	if ((!Path || IsStackEmpty(Robotaxi->Path)) && RobotaxiFinishedFollowPath(Robotaxi->Position, LastPosition))
+	if (IsPathEmpty(Path) && RobotaxiFinishedFollowPath(Robotaxi->Position, LastPosition))
 		return;
 
 	v2 Distance = RobotaxiMoveTowardsPoint(Robotaxi, (point) {(int) (Robotaxi->NextPosition.X), (int) (Robotaxi->NextPosition.Y)});
-	if (Distance.X < ROBOTAXI_SPEED && Distance.Y < ROBOTAXI_SPEED) {
-		Tstack *stack = PopStack(&Robotaxi->Path);
-		Robotaxi->NextPosition = (v2) {stack->Data.Location.Row * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS/2, stack->Data.Location.Col * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS/2};
-		free(stack); 
+	if (Distance.X < ROBOTAXI_SPEED && Distance.Y < ROBOTAXI_SPEED && !IsPathEmpty(Robotaxi->Path)) {
+		point Next = PopPath(Robotaxi->Path);
+		Robotaxi->NextPosition = (v2) {Next.Row * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS/2, Next.Col * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS/2};
+		if (IsPathEmpty(Robotaxi->Path))
+			DestroyPath(&Robotaxi->Path);
 	}
 }
 
+/*
+	Cooperative taxis drive a window of reserved steps towards the next
+	corner of their Path instead of straight down it, so the legs and
+	repairs of the Path steer them all the same.
+*/
+void RobotaxiDrive(robotaxi *Robotaxi, point LastPosition, astar_grid *AStarGrid)
+{
+	if (!COOPERATIVE_ROUTING) {
+		RobotaxiFollowPath(Robotaxi, Robotaxi->Path, LastPosition);
+		return;
+	}
+
+	RobotaxiFollowSteps(Robotaxi, LastPosition, AStarGrid);
+}
+
+/*
+	The taxi only leaves a cell on the first frame of a tick, into the
+	cell its Steps hold for the next one, so it crosses one cell per tick
+	in step with the reservation table. Steps lead to the next corner of
+	the Path, which is popped once the taxi stands on it. Past the last
+	corner the taxi waits in its cell while the next leg of its Route is
+	on the way, and heads for LastPosition when none is. The next window
+	is planned once half of this one is driven, when the corner changes,
+	or as soon as the taxi is not where its Steps say. Returns false once
+	it stands on LastPosition with nothing left to drive.
+*/
+bool RobotaxiFollowSteps(robotaxi *Robotaxi, point LastPosition, astar_grid *AStarGrid)
+{
+	v2 Distance = RobotaxiMoveTowardsPoint(Robotaxi, (point) {(int) (Robotaxi->NextPosition.X), (int) (Robotaxi->NextPosition.Y)});
+	if (Distance.X >= ROBOTAXI_SPEED || Distance.Y >= ROBOTAXI_SPEED)
+		return true;
+
+	robotaxi_dispatcher *Dispatcher = Robotaxi->Dispatcher;
+	reservation_table *Table = Dispatcher->Reservations;
+	int Agent = Robotaxi - Dispatcher->Robotaxis;
+
+	point Cell = {(int) (Robotaxi->NextPosition.X / TILE_SIZE_PIXELS), (int) (Robotaxi->NextPosition.Y / TILE_SIZE_PIXELS)};
+	while (!IsPathEmpty(Robotaxi->Path) && EqualPoints(PeekPath(Robotaxi->Path), Cell)) {
+		PopPath(Robotaxi->Path);
+	}
+	if (IsPathEmpty(Robotaxi->Path))
+		DestroyPath(&Robotaxi->Path);
+
+	bool LegComing = Robotaxi->RouteTicket >= 0 || !IsRouteRefined(Robotaxi->Route);
+	point Goal = IsPathEmpty(Robotaxi->Path) ? (LegComing ? Cell : LastPosition) : PeekPath(Robotaxi->Path);
+	if (EqualPoints(Cell, Goal) && !LegComing) {
+		ReleaseSteps(Table, Robotaxi->Steps, Robotaxi->StepsTick, Agent);
+		DestroyPath(&Robotaxi->Steps);
+		return false;
+	}
+
+	if (Dispatcher->Frame % FRAMES_PER_TICK != 0)
+		return true;
+
+	int Step = Table->Now - Robotaxi->StepsTick;
+	if (Robotaxi->Steps == NULL || !EqualPoints(Robotaxi->StepsGoal, Goal) || Step >= RESERVATION_HORIZON / 2 || Step + 1 >= Robotaxi->Steps->Length ||
+		!EqualPoints(GetPathPoint(Robotaxi->Steps, Step), Cell) ||
+		!IsOpenCellFunction(GetPathPoint(Robotaxi->Steps, Step + 1), AStarGrid)) {
+		ReleaseSteps(Table, Robotaxi->Steps, Robotaxi->StepsTick, Agent);
+		DestroyPath(&Robotaxi->Steps);
+
+		Robotaxi->Steps = FindPathCooperative(Cell, Goal, Agent, Table, AStarGrid, Dispatcher->CooperativeSearch);
+		Robotaxi->StepsTick = Table->Now;
+		Robotaxi->StepsGoal = Goal;
+		Step = 0;
+		if (Robotaxi->Steps == NULL)
+			return true;
+
+		ReserveSteps(Table, Robotaxi->Steps, Robotaxi->StepsTick, Agent);
+		if (Robotaxi->Steps->Length < 2)
+			return true;
+	}
+
+	// set off on this frame already, so the next cell is reached right as the tick ends
+	point Next = GetPathPoint(Robotaxi->Steps, Step + 1);
+	Robotaxi->NextPosition = (v2) {Next.Row * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS/2, Next.Col * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS/2};
+	RobotaxiMoveTowardsPoint(Robotaxi, (point) {(int) (Robotaxi->NextPosition.X), (int) (Robotaxi->NextPosition.Y)});
+	return true;
+}
+
+/*
+	One reservation tick is the time a taxi takes to drive one cell. The
+	table moves on at the start of every tick, before the taxis step.
+*/
+void TickReservations(robotaxi_dispatcher *Dispatcher, astar_grid *AStarGrid)
+{
+	if (!COOPERATIVE_ROUTING)
+		return;
+
+	if (Dispatcher->Reservations == NULL) {
+		Dispatcher->Reservations = CreateReservationTable(AStarGrid, RESERVATION_HORIZON);
+		Dispatcher->CooperativeSearch = CreateCooperativeSearch(AStarGrid, RESERVATION_HORIZON);
+	}
+
+	Dispatcher->Frame++;
+	if (Dispatcher->Frame % FRAMES_PER_TICK == 0)
+		AdvanceReservations(Dispatcher->Reservations);
+}
+
+/*
+	Drives one tick down a distance field instead of a Path: every time
+	the taxi reaches a cell it picks the neighbour one step closer. 
+	Returns false once it stands on a source of the field, or when none
+	can be reached from its cell.
+*/
+bool RobotaxiFollowField(robotaxi *Robotaxi, distance_field *Field, astar_grid *AStarGrid)
+{
+	v2 Distance = RobotaxiMoveTowardsPoint(Robotaxi, (point) {(int) (Robotaxi->NextPosition.X), (int) (Robotaxi->NextPosition.Y)});
+	if (Distance.X >= ROBOTAXI_SPEED || Distance.Y >= ROBOTAXI_SPEED)
+		return true;
+
+	point Cell = {(int) (Robotaxi->NextPosition.X / TILE_SIZE_PIXELS), (int) (Robotaxi->NextPosition.Y / TILE_SIZE_PIXELS)};
+	if (Field == NULL || FieldDistance(Field, AStarGrid, Cell) <= 0)
+		return false;
+
+	point Next = NextFieldStep(Field, AStarGrid, Cell);
+	Robotaxi->NextPosition = (v2) {Next.Row * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS/2, Next.Col * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS/2};
+	return true;
+}
+
 bool RobotaxiFinishedFollowPath(v2 RobotaxiPosition, point LastPosition)
 {
 	if (((RobotaxiPosition.X - TILE_SIZE_PIXELS / 2) / TILE_SIZE_PIXELS) == (double)LastPosition.Row && 
@@ -562,6 +1105,8 @@ point FindParkingSpot(v2 Location, astar_grid *AStarGrid) {
     		}
     	}
     }
+
+    return Point;
 }
 
 v2 GetRobotaxiDirection(robotaxi *Robotaxi, point Point) 
@@ -615,8 +1160,20 @@ void AddRobotaxi(robotaxi *Robotaxi, int *RobotaxisLength, depot *Depots, int De
 	Robotaxi->Position.X = Depots[i].Position.X + TILE_SIZE_PIXELS/2;
 	Robotaxi->Position.Y = Depots[i].Position.Y + TILE_SIZE_PIXELS/2;
 	Robotaxi->NextPosition = Robotaxi->Position;
+	Robotaxi->Order = (order) {0};
 	Robotaxi->Status = ROBOTAXI_AVAILABLE;
+	Robotaxi->NextStatus = ROBOTAXI_AVAILABLE;
+	Robotaxi->RouteTicket = -1;
 	Robotaxi->Path = NULL;
+	Robotaxi->Route = NULL;
+	Robotaxi->PlannedPath = NULL;
+	Robotaxi->PlannedRoute = NULL;
+	Robotaxi->RoutePlanned = false;
+	Robotaxi->Replanner = NULL;
+	Robotaxi->RouteSearch = NULL;
+	Robotaxi->Steps = NULL;
+	Robotaxi->StepsTick = 0;
+	Robotaxi->StepsGoal = (point) {-1, -1};
 	(*RobotaxisLength)++;
 }
 
@@ -655,7 +1212,8 @@ void CreateOrder(Tqueue *Orders, int *OrdersLength, astar_grid *AStarGrid)
 	Order.Status = WAITING;
 
 	if (AStarGrid->Map[(int)(Order.Position.X)][(int)(Order.Position.Y)].MovementCost == 0 &&
-		AStarGrid->Map[(int)(Order.Destination.X)][(int)(Order.Destination.Y)].MovementCost == 0) { 
+		AStarGrid->Map[(int)(Order.Destination.X)][(int)(Order.Destination.Y)].MovementCost == 0 &&
+		AreConnected(FindParkingSpot(Order.Position, AStarGrid), FindParkingSpot(Order.Destination, AStarGrid), AStarGrid)) { 
 		DEBUG_PRINTL("->Order: (%.0f %.0f) (%.0f %.0f)\n", Order.Position.X, Order.Position.Y, Order.Destination.X, Order.Destination.Y);
 		PushQueue(Orders, &Order);
 		(*OrdersLength)++;
@@ -664,22 +1222,6 @@ void CreateOrder(Tqueue *Orders, int *OrdersLength, astar_grid *AStarGrid)
 	}
 }
 
-v2 FindClosestDepot(v2 RobotaxiPosition, depot *Depots, int DepotsLength)
-{	
-	v2 ClosestDepot = {0};
-	double Distance = INT_MAX;
-	for (int i = 0; i < DepotsLength; i++) {
-		double NewDistance = abs(RobotaxiPosition.X - Depots[i].Position.X) + abs(RobotaxiPosition.Y - Depots[i].Position.Y);
-		if (NewDistance < Distance) {
-			Distance = NewDistance;
-			ClosestDepot.X = Depots[i].Position.X;
-			ClosestDepot.Y = Depots[i].Position.Y;
-		}
-	}
-
-	return ClosestDepot;
-}
-
 void RobotaxisReturnToDepots(robotaxi *Robotaxis, int RobotaxisLength)
 {
 	for (int i = 0; i < RobotaxisLength; i++) {
@@ -703,19 +1245,19 @@ int my_random_function()
     return (rand() % 2);
 }
 
-void DrawPath(Tstack **Path) 
+void DrawPath(Tpath *Path) 
 {	
-	if (*Path == NULL || IsStackEmpty(*Path))
+	if (IsPathEmpty(Path))
 		return;
 
-	Tstack *temp = *Path;
-	while (temp != NULL) {
-		cell Cell = temp->Data;
-		SDL_FRect r = {.x = TILE_SIZE_PIXELS * Cell.Location.Col, 
-					   .y = TILE_SIZE_PIXELS * Cell.Location.Row, 
-					   .w = TILE_SIZE_PIXELS, .h = TILE_SIZE_PIXELS};
+	for (int i = Path->Cursor; i < Path->Length; i++) {
+		point From = GetPathPoint(Path, i > Path->Cursor ? i - 1 : i);
+		point To = GetPathPoint(Path, i);
+		SDL_FRect r = {.x = TILE_SIZE_PIXELS * fmin(From.Col, To.Col), 
+					   .y = TILE_SIZE_PIXELS * fmin(From.Row, To.Row), 
+					   .w = TILE_SIZE_PIXELS * (abs(From.Col - To.Col) + 1), 
+					   .h = TILE_SIZE_PIXELS * (abs(From.Row - To.Row) + 1)};
 		DrawRectangle(r, 0, 0, 205);	
-		temp = temp->next;
 	}
 }
 
@@ -734,7 +1276,8 @@ void DrawRobotaxi(robotaxi *Robotaxi)
 
 	DrawRectangle(r, 248, 215, 99);
 
-	if (Robotaxi->Status == ROBOTAXI_TO_ORDER || Robotaxi->Status == ROBOTAXI_TO_DEST)
+	if (Robotaxi->Status == ROBOTAXI_TO_ORDER || Robotaxi->Status == ROBOTAXI_TO_DEST ||
+		(Robotaxi->Status == ROBOTAXI_WAITING_FOR_ROUTE && Robotaxi->NextStatus == ROBOTAXI_TO_DEST))
 		DrawOrder(&Robotaxi->Order);
 
 }
@@ -843,8 +1386,24 @@ void DrawTilemap(tilemap *Tilemap)
 
 void DestroyDispatcher(robotaxi_dispatcher *Dispatcher)
 {
+	for (int i = 0; i < Dispatcher->RobotaxisLength; i++) {
+		DestroyPath(&Dispatcher->Robotaxis[i].Path);
+		DestroyPath(&Dispatcher->Robotaxis[i].Route);
+		DestroyPath(&Dispatcher->Robotaxis[i].PlannedPath);
+		DestroyPath(&Dispatcher->Robotaxis[i].PlannedRoute);
+		DestroyPath(&Dispatcher->Robotaxis[i].Steps);
+		DestroyDStarSearch(Dispatcher->Robotaxis[i].Replanner);
+		if (Dispatcher->Robotaxis[i].RouteSearch != NULL)
+			DestroyAStarSearch(Dispatcher->Robotaxis[i].RouteSearch);
+	}
+
 	free(Dispatcher->Robotaxis);
 	free(Dispatcher->Depots);
+	DestroyDistanceField(Dispatcher->DepotField);
+	if (Dispatcher->Search != NULL)
+		DestroyAStarSearch(Dispatcher->Search);
+	DestroyReservationTable(Dispatcher->Reservations);
+	DestroyCooperativeSearch(Dispatcher->CooperativeSearch);
 	DestroyQueue(&Dispatcher->Orders);
 	free(Dispatcher);
 }
@@ -855,6 +1414,15 @@ void DestroyAStarGrid(astar_grid * AStarGrid)
 		free(AStarGrid->Map[i]);
 	}
 
+	DestroyLandmarks(AStarGrid->Landmarks);
+	DestroyHierarchy(AStarGrid->Hierarchy);
+	DestroyRoadGraph(AStarGrid->Roads);
+	if (AStarGrid->Contraction != NULL)
+		DestroyContraction(AStarGrid->Contraction);
+	if (AStarGrid->HubLabels != NULL)
+		DestroyHubLabels(AStarGrid->HubLabels);
+	DestroyComponents(AStarGrid->Components);
+	DestroyPassability(AStarGrid->Passability);
 	free(AStarGrid->Map);
 	free(AStarGrid);
 }
@@ -862,6 +1430,11 @@ void DestroyAStarGrid(astar_grid * AStarGrid)
 void DestroyGameState(game_state *GameState)
 {
 	free(GameState->Tilemap.Tiles);
+	if (GameState->Planner->Cache != NULL) {
+		DEBUG_PRINTL("Route cache: %d hits, %d misses\n", GameState->Planner->Cache->Hits, GameState->Planner->Cache->Misses);
+	}
+	DestroyPathPlanner(GameState->Planner);
+	DestroyGridRebuild(GameState->Rebuild);
 	DestroyAStarGrid(GameState->AStarGrid);
 	DestroyDispatcher(GameState->Dispatcher);
 	DestroyQueue(&GameState->Commands);
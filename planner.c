@@ -0,0 +1,504 @@
+#include "planner.h"
+
+static void PushPathJob(path_job **Head, path_job **Tail, path_job *Job) 
+{
+    Job->Next = NULL;
+    if (*Tail != NULL)
+        (*Tail)->Next = Job;
+    else
+        *Head = Job;
+    *Tail = Job;
+}
+
+static path_job * PopPathJob(path_job **Head, path_job **Tail) 
+{
+    path_job *Job = *Head;
+    *Head = Job->Next;
+    if (*Head == NULL)
+        *Tail = NULL;
+    return Job;
+}
+
+/* Unlinks the job with Ticket from a list, or returns NULL when it is not there. */
+static path_job * TakePathJob(path_job **Head, path_job **Tail, int Ticket) 
+{
+    path_job *Previous = NULL;
+    path_job *Job = *Head;
+    while (Job != NULL && Job->Ticket != Ticket) {
+        Previous = Job;
+        Job = Job->Next;
+    }
+
+    if (Job == NULL)
+        return NULL;
+
+    if (Previous != NULL)
+        Previous->Next = Job->Next;
+    else
+        *Head = Job->Next;
+    if (*Tail == Job)
+        *Tail = Previous;
+    return Job;
+}
+
+static void DestroyPathJobs(path_job *Job) 
+{
+    while (Job != NULL) {
+        path_job *Next = Job->Next;
+        DestroyPath(&Job->Request.Path);
+        DestroyPath(&Job->Request.Route);
+        free(Job);
+        Job = Next;
+    }
+}
+
+static bool IsSlicedRequest(path_planner *Planner, path_request *Request, astar_search *Search) 
+{
+    return Planner->ExpansionBudget > 0 && Request->Resume != NULL && Search->Mode != SEARCH_MODE_HIERARCHICAL 
+        && Search->Mode != SEARCH_MODE_ROAD_GRAPH && Search->Mode != SEARCH_MODE_CONTRACTION
+        && Search->Mode != SEARCH_MODE_ANYTIME && Search->Mode != SEARCH_MODE_BUCKET;
+}
+
+/*
+    The legs of a hierarchical route are plain grid searches between two
+    waypoints, so they are sliced whenever there is a budget.
+*/
+static bool IsSlicedLeg(path_planner *Planner, path_request *Request, astar_search *Search) 
+{
+    return Planner->ExpansionBudget > 0 && Request->Resume != NULL 
+        && (Request->Route != NULL || Search->Mode == SEARCH_MODE_HIERARCHICAL);
+}
+
+static bool IsResumingSearch(astar_search *Resume, point Start, point End) 
+{
+    return Resume != NULL && Resume->Status == SEARCH_RUNNING 
+        && EqualPoints(Resume->Start, Start) && EqualPoints(Resume->End, End);
+}
+
+/*
+    Continues the request's own search from Start to End for Budget 
+    expansions, starting it over when it was searching for something 
+    else. What the turn cost goes to Request->Expanded.
+*/
+static Tpath * RunSlicedRequest(path_planner *Planner, path_request *Request, point Start, point End, astar_search *Search, int Budget) 
+{
+    astar_search *Resume = Request->Resume;
+    Resume->Heuristic = Search->Heuristic;
+    Resume->Mode = Search->Mode;
+    Resume->Weight = Search->Weight;
+
+    if (!IsResumingSearch(Resume, Start, End))
+        StartPathSearch(Start, End, Planner->Grid, Resume);
+
+    int Before = Resume->Expanded;
+    search_status Status = ContinuePathSearch(Planner->Grid, Resume, Budget);
+    Request->Expanded = Resume->Expanded >= Before ? Resume->Expanded - Before : Budget;
+    if (Status == SEARCH_RUNNING) {
+        Request->Pending = true;
+        return NULL;
+    }
+
+    return FinishPathSearch(Resume);
+}
+
+/*
+    Refines the next leg of Request->Route. A sliced leg leaves the 
+    Route cursor where it is until the leg is found.
+*/
+static Tpath * RunLegRequest(path_planner *Planner, path_request *Request, astar_search *Search, int Budget) 
+{
+    astar_grid *Grid = Planner->Grid;
+    if (!IsSlicedLeg(Planner, Request, Search))
+        return RefineHierarchicalRoute(Request->Route, Grid, Search);
+
+    point From, To;
+    int Next = NextRouteLeg(Request->Route, &From, &To);
+    if (Next < 0)
+        return NULL;
+
+    Tpath *Leg = NULL;
+    if (IsWalkable(From, Grid) && IsWalkable(To, Grid)) {
+        Leg = RunSlicedRequest(Planner, Request, From, To, Search, Budget);
+        if (Request->Pending)
+            return NULL;
+    }
+
+    Request->Route->Cursor = Next;
+    return Leg;
+}
+
+/*
+    The route cache holds what the search itself returns: the full path,
+    or the abstract Route in SEARCH_MODE_HIERARCHICAL.
+*/
+static Tpath * RunPathRequest(path_planner *Planner, path_request *Request, astar_search *Search, int Budget) 
+{
+    astar_grid *Grid = Planner->Grid;
+    Request->Pending = false;
+    Request->Expanded = 0;
+    Request->Version = Grid->Version;
+    if (Request->Route != NULL)
+        return RunLegRequest(Planner, Request, Search, Budget);
+
+    // a taxi already there gets the one cell in every mode, without a Route
+    if (EqualPoints(Request->Start, Request->End))
+        return FindPath(Request->Start, Request->End, Grid, Search);
+
+    Tpath *Found = NULL;
+    bool Resuming = IsResumingSearch(Request->Resume, Request->Start, Request->End);
+    if (Planner->Cache == NULL || Resuming || !LookupRoute(Planner->Cache, Request->Start, Request->End, Grid, &Found)) {
+        if (IsSlicedRequest(Planner, Request, Search)) {
+            Found = RunSlicedRequest(Planner, Request, Request->Start, Request->End, Search, Budget);
+            if (Request->Pending)
+                return NULL;
+        } else if (Search->Mode == SEARCH_MODE_HIERARCHICAL) {
+            Found = FindHierarchicalRoute(Request->Start, Request->End, Grid, Search);
+        } else {
+            Found = FindPath(Request->Start, Request->End, Grid, Search);
+        }
+
+        if (Planner->Cache != NULL)
+            StoreRoute(Planner->Cache, Request->Start, Request->End, Found, Grid);
+    }
+
+    if (Search->Mode == SEARCH_MODE_HIERARCHICAL) {
+        Request->Route = Found;
+        return RunLegRequest(Planner, Request, Search, Budget);
+    }
+
+    return Found;
+}
+
+static bool IsOutOfBudget(path_planner *Planner) 
+{
+    return Planner->ExpansionBudget > 0 && Planner->BudgetLeft <= 0;
+}
+
+/*
+    Runs one submitted job on a worker, called and returning with Lock
+    held. Each turn takes at most an even share of the frame's budget
+    between the workers, and gives back what it did not expand. A 
+    sliced search that used up its turn goes to the back of the queue
+    so long searches do not hold up short ones.
+*/
+static void RunPathJob(path_planner *Planner, path_worker *Worker) 
+{
+    path_job *Job = PopPathJob(&Planner->Waiting, &Planner->WaitingTail);
+    int Budget = INT_MAX;
+    if (Planner->ExpansionBudget > 0) {
+        Budget = Planner->ExpansionBudget / Planner->WorkersLength;
+        if (Budget < 1)
+            Budget = 1;
+        if (Budget > Planner->BudgetLeft)
+            Budget = Planner->BudgetLeft;
+        Planner->BudgetLeft -= Budget;
+    }
+    Planner->RunningJobs++;
+    Worker->Ticket = Job->Ticket;
+    pthread_mutex_unlock(&Planner->Lock);
+
+    Job->Request.Path = RunPathRequest(Planner, &Job->Request, Worker->Search, Budget);
+
+    pthread_mutex_lock(&Planner->Lock);
+    if (Planner->ExpansionBudget > 0)
+        Planner->BudgetLeft += Budget - Job->Request.Expanded;
+    if (Job->Request.Pending)
+        PushPathJob(&Planner->Waiting, &Planner->WaitingTail, Job);
+    else
+        PushPathJob(&Planner->Finished, &Planner->FinishedTail, Job);
+
+    // CancelPathRequest waits for this one job, BeginGridEdit for all of them
+    Worker->Ticket = -1;
+    Planner->RunningJobs--;
+    pthread_cond_broadcast(&Planner->WorkDone);
+}
+
+static void * PathWorker(void *Argument) 
+{
+    path_worker *Worker = (path_worker*) Argument;
+    path_planner *Planner = Worker->Planner;
+
+    pthread_mutex_lock(&Planner->Lock);
+    for (;;) {
+        while (!Planner->Quit && (Planner->Waiting == NULL || Planner->Editing || IsOutOfBudget(Planner))) {
+            pthread_cond_wait(&Planner->WorkReady, &Planner->Lock);
+        }
+
+        if (Planner->Quit)
+            break;
+
+        RunPathJob(Planner, Worker);
+    }
+    pthread_mutex_unlock(&Planner->Lock);
+
+    return NULL;
+}
+
+path_planner * CreatePathPlanner(astar_grid *Grid, int WorkersLength, int CacheCapacity) 
+{
+    path_planner *Planner = (path_planner*) malloc(sizeof(path_planner));
+    Planner->Grid = Grid;
+    Planner->Search = CreateAStarSearch(Grid);
+    Planner->Cache = CacheCapacity > 0 ? CreateRouteCache(CacheCapacity) : NULL;
+    Planner->ExpansionBudget = 0;
+    Planner->BudgetLeft = 0;
+    Planner->Waiting = Planner->WaitingTail = NULL;
+    Planner->Finished = Planner->FinishedTail = NULL;
+    Planner->NextTicket = 0;
+    Planner->RunningJobs = 0;
+    Planner->Editing = false;
+    Planner->Quit = false;
+
+    pthread_mutex_init(&Planner->Lock, NULL);
+    pthread_cond_init(&Planner->WorkReady, NULL);
+    pthread_cond_init(&Planner->WorkDone, NULL);
+
+    Planner->Workers = (path_worker*) malloc(WorkersLength * sizeof(path_worker));
+    Planner->WorkersLength = 0;
+    for (int i = 0; i < WorkersLength; i++) {
+        path_worker *Worker = &Planner->Workers[Planner->WorkersLength];
+        Worker->Planner = Planner;
+        Worker->Search = CreateAStarSearch(Grid);
+        Worker->Ticket = -1;
+
+        if (pthread_create(&Worker->Thread, NULL, PathWorker, Worker) != 0) {
+            DEBUG_PRINTL("Could not start path worker %d\n", i);
+            DestroyAStarSearch(Worker->Search);
+            break;
+        }
+
+        Planner->WorkersLength++;
+    }
+
+    return Planner;
+}
+
+void SetPathPlannerMode(path_planner *Planner, search_mode Mode) 
+{
+    if (Planner->Cache != NULL)
+        FlushRouteCache(Planner->Cache);
+
+    Planner->Search->Mode = Mode;
+    for (int i = 0; i < Planner->WorkersLength; i++) {
+        Planner->Workers[i].Search->Mode = Mode;
+    }
+}
+
+void SetPathPlannerHeuristic(path_planner *Planner, heuristic_type Heuristic) 
+{
+    Planner->Search->Heuristic = Heuristic;
+    for (int i = 0; i < Planner->WorkersLength; i++) {
+        Planner->Workers[i].Search->Heuristic = Heuristic;
+    }
+}
+
+/*
+    Weight for SEARCH_MODE_WEIGHTED and the one SEARCH_MODE_ANYTIME 
+    starts from, which then gets AnytimeBudget expansions to improve its
+    first route.
+*/
+void SetPathPlannerWeight(path_planner *Planner, double Weight, int AnytimeBudget) 
+{
+    if (Planner->Cache != NULL)
+        FlushRouteCache(Planner->Cache);
+
+    Planner->Search->Weight = Weight;
+    Planner->Search->AnytimeBudget = AnytimeBudget;
+    for (int i = 0; i < Planner->WorkersLength; i++) {
+        Planner->Workers[i].Search->Weight = Weight;
+        Planner->Workers[i].Search->AnytimeBudget = AnytimeBudget;
+    }
+}
+
+/*
+    With a budget, the submitted jobs expand at most ExpansionBudget 
+    nodes between two RefillPathBudget calls, all workers together. 0 
+    lets every search run to the end.
+*/
+void SetPathPlannerBudget(path_planner *Planner, int ExpansionBudget) 
+{
+    Planner->ExpansionBudget = ExpansionBudget;
+    RefillPathBudget(Planner);
+}
+
+/*
+    Hands the submitted jobs a new ExpansionBudget, once per frame. What
+    was left over from the last one does not carry on.
+*/
+void RefillPathBudget(path_planner *Planner) 
+{
+    pthread_mutex_lock(&Planner->Lock);
+    Planner->BudgetLeft = Planner->ExpansionBudget;
+    pthread_cond_broadcast(&Planner->WorkReady);
+    pthread_mutex_unlock(&Planner->Lock);
+}
+
+/*
+    Without workers the job is planned right here, to the end.
+*/
+static void QueuePathJob(path_planner *Planner, path_job *Job) 
+{
+    pthread_mutex_lock(&Planner->Lock);
+    if (Planner->WorkersLength > 0) {
+        PushPathJob(&Planner->Waiting, &Planner->WaitingTail, Job);
+        pthread_cond_signal(&Planner->WorkReady);
+        pthread_mutex_unlock(&Planner->Lock);
+        return;
+    }
+    pthread_mutex_unlock(&Planner->Lock);
+
+    Job->Request.Path = RunPathRequest(Planner, &Job->Request, Planner->Search, INT_MAX);
+
+    pthread_mutex_lock(&Planner->Lock);
+    PushPathJob(&Planner->Finished, &Planner->FinishedTail, Job);
+    pthread_mutex_unlock(&Planner->Lock);
+}
+
+/*
+    A job that finished before the last grid edit may cross a cell that
+    is closed now, so it goes back to the queue as it was submitted.
+*/
+static bool RetryStalePathJob(path_planner *Planner, path_job *Job) 
+{
+    if (Job->Request.Version == Planner->Grid->Version)
+        return false;
+
+    DestroyPath(&Job->Request.Path);
+    if (Job->Request.Route != Job->Submitted.Route)
+        DestroyPath(&Job->Request.Route);
+    Job->Request = Job->Submitted;
+    if (Job->Request.Route != NULL)
+        Job->Request.Route->Cursor = Job->RouteCursor;
+
+    QueuePathJob(Planner, Job);
+    return true;
+}
+
+/*
+    Queues a copy of Request for the workers and returns its ticket at
+    once. The finished request comes back through Callback when the 
+    caller runs DispatchFinishedPaths, on the caller's own thread.
+*/
+int SubmitPathRequest(path_planner *Planner, path_request *Request, path_callback Callback, void *Data) 
+{
+    path_job *Job = (path_job*) malloc(sizeof(path_job));
+    Job->Submitted = *Request;
+    Job->Submitted.Path = NULL;
+    Job->Submitted.Pending = false;
+    Job->Request = Job->Submitted;
+    Job->RouteCursor = Request->Route != NULL ? Request->Route->Cursor : 0;
+    Job->Callback = Callback;
+    Job->Data = Data;
+
+    pthread_mutex_lock(&Planner->Lock);
+    int Ticket = Job->Ticket = Planner->NextTicket++;
+    pthread_mutex_unlock(&Planner->Lock);
+
+    QueuePathJob(Planner, Job);
+    return Ticket;
+}
+
+static bool IsRunningPathJob(path_planner *Planner, int Ticket) 
+{
+    for (int i = 0; i < Planner->WorkersLength; i++) {
+        if (Planner->Workers[i].Ticket == Ticket)
+            return true;
+    }
+
+    return false;
+}
+
+/*
+    Takes the job with Ticket out of the planner, queued or finished, 
+    and frees what it planned along with the Route it was lent. A job
+    that is running is waited for first, so its Resume search is free
+    again once this returns. Does nothing for a job already handed back.
+*/
+void CancelPathRequest(path_planner *Planner, int Ticket) 
+{
+    pthread_mutex_lock(&Planner->Lock);
+    while (IsRunningPathJob(Planner, Ticket)) {
+        pthread_cond_wait(&Planner->WorkDone, &Planner->Lock);
+    }
+
+    path_job *Job = TakePathJob(&Planner->Waiting, &Planner->WaitingTail, Ticket);
+    if (Job == NULL)
+        Job = TakePathJob(&Planner->Finished, &Planner->FinishedTail, Ticket);
+    pthread_mutex_unlock(&Planner->Lock);
+
+    if (Job != NULL) {
+        Job->Next = NULL;
+        DestroyPathJobs(Job);
+    }
+}
+
+/*
+    Hands every finished job to its callback, which owns Path and Route
+    from then on. Returns how many were dispatched.
+*/
+int DispatchFinishedPaths(path_planner *Planner) 
+{
+    pthread_mutex_lock(&Planner->Lock);
+    path_job *Job = Planner->Finished;
+    Planner->Finished = Planner->FinishedTail = NULL;
+    pthread_mutex_unlock(&Planner->Lock);
+
+    int Dispatched = 0;
+    while (Job != NULL) {
+        path_job *Next = Job->Next;
+        if (!RetryStalePathJob(Planner, Job)) {
+            Job->Callback(&Job->Request, Job->Data);
+            free(Job);
+            Dispatched++;
+        }
+        Job = Next;
+    }
+
+    return Dispatched;
+}
+
+/*
+    Holds the workers off the job queue and waits for the jobs already
+    running, so nothing reads the grid while it or the tables derived 
+    from it change. Jobs still queued resume after EndGridEdit.
+*/
+void BeginGridEdit(path_planner *Planner) 
+{
+    pthread_mutex_lock(&Planner->Lock);
+    Planner->Editing = true;
+    while (Planner->RunningJobs > 0) {
+        pthread_cond_wait(&Planner->WorkDone, &Planner->Lock);
+    }
+    pthread_mutex_unlock(&Planner->Lock);
+}
+
+void EndGridEdit(path_planner *Planner) 
+{
+    pthread_mutex_lock(&Planner->Lock);
+    Planner->Editing = false;
+    pthread_cond_broadcast(&Planner->WorkReady);
+    pthread_mutex_unlock(&Planner->Lock);
+}
+
+void DestroyPathPlanner(path_planner *Planner) 
+{
+    pthread_mutex_lock(&Planner->Lock);
+    Planner->Quit = true;
+    pthread_cond_broadcast(&Planner->WorkReady);
+    pthread_mutex_unlock(&Planner->Lock);
+
+    for (int i = 0; i < Planner->WorkersLength; i++) {
+        pthread_join(Planner->Workers[i].Thread, NULL);
+        DestroyAStarSearch(Planner->Workers[i].Search);
+    }
+
+    DestroyPathJobs(Planner->Waiting);
+    DestroyPathJobs(Planner->Finished);
+    pthread_cond_destroy(&Planner->WorkDone);
+    pthread_cond_destroy(&Planner->WorkReady);
+    pthread_mutex_destroy(&Planner->Lock);
+    DestroyAStarSearch(Planner->Search);
+    DestroyRouteCache(Planner->Cache);
+    free(Planner->Workers);
+    free(Planner);
+}
@@ -0,0 +1,82 @@
+/*
+	In SEARCH_MODE_HIERARCHICAL a request comes back with the abstract
+	Route and only its first leg in Path. Sending the Route back in a 
+	later request refines the next leg.
+
+	Resume is a search owned by the caller that keeps a sliced search
+	(or the leg of a hierarchical route) alive between turns while the
+	planner has an ExpansionBudget; a request that ran out of budget 
+	comes back Pending and is continued when it is sent again.
+
+	Version is the grid Version the Path was planned on, and Expanded
+	what its sliced search spent on the last turn.
+*/
+typedef struct path_request {
+	int Id;
+	point Start, End;
+	Tpath *Path;
+	Tpath *Route;
+	astar_search *Resume;
+	bool Pending;
+	unsigned Version;
+	int Expanded;
+} path_request;
+
+typedef void (*path_callback)(path_request *Request, void *Data);
+
+typedef struct path_job {
+	int Ticket;
+	path_request Submitted;
+	int RouteCursor;
+	path_request Request;
+	path_callback Callback;
+	void *Data;
+	struct path_job *Next;
+} path_job;
+
+typedef struct path_worker {
+	pthread_t Thread;
+	astar_search *Search;
+	int Ticket;
+	struct path_planner *Planner;
+} path_worker;
+
+/*
+	Plans submitted routes on worker threads, each with its own 
+	astar_search, all reading the same astar_grid: Waiting holds the 
+	queued jobs, Finished the ones the caller has not collected yet.
+*/
+typedef struct path_planner {
+	astar_grid *Grid;
+	astar_search *Search;
+	route_cache *Cache;
+	path_worker *Workers;
+	int WorkersLength;
+
+	pthread_mutex_t Lock;
+	pthread_cond_t WorkReady;
+	pthread_cond_t WorkDone;
+	bool Quit;
+
+	int ExpansionBudget;
+	int BudgetLeft;
+
+	path_job *Waiting, *WaitingTail;
+	path_job *Finished, *FinishedTail;
+	int NextTicket;
+	int RunningJobs;
+	bool Editing;
+} path_planner;
+
+path_planner *		CreatePathPlanner(astar_grid *Grid, int WorkersLength, int CacheCapacity);
+void 				SetPathPlannerMode(path_planner *Planner, search_mode Mode);
+void 				SetPathPlannerHeuristic(path_planner *Planner, heuristic_type Heuristic);
+void 				SetPathPlannerWeight(path_planner *Planner, double Weight, int AnytimeBudget);
+void 				SetPathPlannerBudget(path_planner *Planner, int ExpansionBudget);
+void 				RefillPathBudget(path_planner *Planner);
+int 				SubmitPathRequest(path_planner *Planner, path_request *Request, path_callback Callback, void *Data);
+void 				CancelPathRequest(path_planner *Planner, int Ticket);
+int 				DispatchFinishedPaths(path_planner *Planner);
+void 				BeginGridEdit(path_planner *Planner);
+void 				EndGridEdit(path_planner *Planner);
+void 				DestroyPathPlanner(path_planner *Planner);
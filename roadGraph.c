@@ -0,0 +1,444 @@
+#include "roadGraph.h"
+
+static int RoadDegree(point Location, astar_grid *Grid)
+{
+    const int Directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    int Degree = 0;
+
+    for (int k = 0; k < 4; k++) {
+        if (IsWalkable((point) {Location.Row + Directions[k][0], Location.Col + Directions[k][1]}, Grid))
+            Degree++;
+    }
+
+    return Degree;
+}
+
+static int RoadNodeAt(road_graph *Roads, astar_grid *Grid, point Location)
+{
+    return Roads->NodeAt[Location.Row * Grid->NumberCols + Location.Col];
+}
+
+/*
+    The open neighbour of a corridor cell other than the one the walk
+    came from. Corridor cells have exactly two, so there always is one.
+*/
+static point NextCorridorCell(point Current, point Previous, astar_grid *Grid)
+{
+    const int Directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+    for (int k = 0; k < 4; k++) {
+        point Neighbour = {Current.Row + Directions[k][0], Current.Col + Directions[k][1]};
+        if (IsWalkable(Neighbour, Grid) && !EqualPoints(Neighbour, Previous))
+            return Neighbour;
+    }
+
+    return Current;
+}
+
+static void AddRoadEdge(road_node *Node, int To, int Cost)
+{
+    for (int i = 0; i < Node->EdgesLength; i++) {
+        if (Node->Edges[i].To == To) {
+            if (Cost < Node->Edges[i].Cost)
+                Node->Edges[i].Cost = Cost;
+            return;
+        }
+    }
+
+    if (Node->EdgesLength >= Node->EdgesCapacity) {
+        Node->EdgesCapacity = Node->EdgesCapacity > 0 ? Node->EdgesCapacity * 2 : 4;
+        Node->Edges = (road_edge*) realloc(Node->Edges, Node->EdgesCapacity * sizeof(road_edge));
+    }
+
+    Node->Edges[Node->EdgesLength++] = (road_edge) {To, Cost};
+}
+
+static int AddRoadNode(road_graph *Roads, astar_grid *Grid, point Location)
+{
+    if (Roads->NodesLength >= Roads->NodesCapacity) {
+        Roads->NodesCapacity = Roads->NodesCapacity > 0 ? Roads->NodesCapacity * 2 : 64;
+        Roads->Nodes = (road_node*) realloc(Roads->Nodes, Roads->NodesCapacity * sizeof(road_node));
+    }
+
+    road_node *Node = &Roads->Nodes[Roads->NodesLength];
+    Node->Location = Location;
+    Node->Edges = NULL;
+    Node->EdgesLength = 0;
+    Node->EdgesCapacity = 0;
+
+    Roads->NodeAt[Location.Row * Grid->NumberCols + Location.Col] = Roads->NodesLength;
+    return Roads->NodesLength++;
+}
+
+/*
+    Follows every corridor leaving node u to the node at its far end,
+    marking the corridor cells on the way.
+*/
+static void TraceRoadEdges(road_graph *Roads, astar_grid *Grid, int u, bool *Visited)
+{
+    const int Directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    point From = Roads->Nodes[u].Location;
+
+    for (int k = 0; k < 4; k++) {
+        point Previous = From;
+        point Current = {From.Row + Directions[k][0], From.Col + Directions[k][1]};
+        if (!IsWalkable(Current, Grid))
+            continue;
+
+        int Length = 1;
+        while (RoadNodeAt(Roads, Grid, Current) < 0) {
+            Visited[Current.Row * Grid->NumberCols + Current.Col] = true;
+            point Next = NextCorridorCell(Current, Previous, Grid);
+            Previous = Current;
+            Current = Next;
+            Length++;
+        }
+
+        int v = RoadNodeAt(Roads, Grid, Current);
+        if (v != u) {
+            AddRoadEdge(&Roads->Nodes[u], v, Length);
+            Roads->EdgesLength++;
+        }
+    }
+}
+
+static void ClearRoadGraph(road_graph *Roads)
+{
+    for (int i = 0; i < Roads->NodesLength; i++) {
+        free(Roads->Nodes[i].Edges);
+    }
+
+    Roads->NodesLength = 0;
+    Roads->EdgesLength = 0;
+}
+
+road_graph * CreateRoadGraph(astar_grid *Grid)
+{
+    road_graph *Roads = (road_graph*) malloc(sizeof(road_graph));
+    Roads->CellsLength = Grid->NumberRows * Grid->NumberCols;
+    Roads->Nodes = NULL;
+    Roads->NodesLength = 0;
+    Roads->NodesCapacity = 0;
+    Roads->EdgesLength = 0;
+    Roads->NodeAt = (int*) malloc(Roads->CellsLength * sizeof(int));
+    BuildRoadGraph(Roads, Grid);
+
+    return Roads;
+}
+
+void BuildRoadGraph(road_graph *Roads, astar_grid *Grid)
+{
+    bool *Visited = (bool*) calloc(Roads->CellsLength, sizeof(bool));
+
+    ClearRoadGraph(Roads);
+    Roads->OpenCellsLength = 0;
+    for (int i = 0; i < Roads->CellsLength; i++) {
+        point Location = {i / Grid->NumberCols, i % Grid->NumberCols};
+        Roads->NodeAt[i] = -1;
+
+        if (!IsWalkable(Location, Grid))
+            continue;
+
+        Roads->OpenCellsLength++;
+        if (RoadDegree(Location, Grid) != 2)
+            AddRoadNode(Roads, Grid, Location);
+    }
+
+    for (int u = 0; u < Roads->NodesLength; u++) {
+        TraceRoadEdges(Roads, Grid, u, Visited);
+    }
+
+    // a corridor closed on itself has no node yet: one of its cells becomes one
+    for (int i = 0; i < Roads->CellsLength; i++) {
+        point Location = {i / Grid->NumberCols, i % Grid->NumberCols};
+        if (Visited[i] || Roads->NodeAt[i] >= 0 || !IsWalkable(Location, Grid))
+            continue;
+
+        Visited[i] = true;
+        TraceRoadEdges(Roads, Grid, AddRoadNode(Roads, Grid, Location), Visited);
+    }
+
+    free(Visited);
+    Roads->Version = Grid->Version;
+}
+
+void DestroyRoadGraph(road_graph *Roads)
+{
+    ClearRoadGraph(Roads);
+    free(Roads->Nodes);
+    free(Roads->NodeAt);
+    free(Roads);
+}
+
+/*
+    Where a cell joins the graph: itself when it is a node, otherwise
+    the nodes at both ends of its corridor and how far away they are.
+    A walk that runs into Stop first records it in *StopCost instead,
+    and as an anchor too when Stop is a node.
+*/
+static int AnchorRoadCell(road_graph *Roads, astar_grid *Grid, point Location, point Stop, road_edge *Anchors, int *StopCost)
+{
+    const int Directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    int u = RoadNodeAt(Roads, Grid, Location);
+    if (u >= 0) {
+        Anchors[0] = (road_edge) {u, 0};
+        return 1;
+    }
+
+    int Length = 0;
+    for (int k = 0; k < 4; k++) {
+        point Previous = Location;
+        point Current = {Location.Row + Directions[k][0], Location.Col + Directions[k][1]};
+        if (!IsWalkable(Current, Grid))
+            continue;
+
+        int Cost = 1;
+        while (!EqualPoints(Current, Stop) && RoadNodeAt(Roads, Grid, Current) < 0) {
+            point Next = NextCorridorCell(Current, Previous, Grid);
+            Previous = Current;
+            Current = Next;
+            Cost++;
+        }
+
+        if (EqualPoints(Current, Stop) && (*StopCost < 0 || Cost < *StopCost))
+            *StopCost = Cost;
+        // a Stop that is a node anchors no walk of its own, so it has to be one here
+        if (RoadNodeAt(Roads, Grid, Current) >= 0)
+            Anchors[Length++] = (road_edge) {RoadNodeAt(Roads, Grid, Current), Cost};
+    }
+
+    return Length;
+}
+
+static point RoadLocation(road_graph *Roads, int u, point Start, point End)
+{
+    if (u == Roads->NodesLength)
+        return Start;
+    if (u == Roads->NodesLength + 1)
+        return End;
+    return Roads->Nodes[u].Location;
+}
+
+/*
+    A* over the road graph, with Start and End plugged in as two extra
+    nodes linked to the ends of their corridors (or straight to each
+    other when they share one). The per-query node state lives in the
+    search's stamped GraphNodes, like the hierarchical search's: a query
+    only touches the nodes it reaches instead of clearing all of them, 
+    and the road_graph stays read-only, so every planner worker can 
+    query it at once through its own astar_search.
+
+    Returns the waypoints (Start, nodes..., End) as a Tpath, or NULL
+    when End cannot be reached or the graph is out of date.
+*/
+Tpath * FindRoadRoute(point Start, point End, astar_grid *Grid, astar_search *Search)
+{
+    road_graph *Roads = Grid->Roads;
+
+    if (Roads == NULL || Roads->Version != Grid->Version || !AreConnected(Start, End, Grid) || EqualPoints(Start, End))
+        return NULL;
+
+    road_edge StartAnchors[4], EndAnchors[4];
+    int Direct = -1, Unused = -1;
+    int StartAnchorsLength = AnchorRoadCell(Roads, Grid, Start, End, StartAnchors, &Direct);
+    int EndAnchorsLength = AnchorRoadCell(Roads, Grid, End, Start, EndAnchors, &Unused);
+
+    int StartNode = Roads->NodesLength;
+    int EndNode = Roads->NodesLength + 1;
+    BeginSearch(Search);
+    search_node *Nodes = UseGraphNodes(Search, Roads->NodesLength + 2);
+    Theap *OpenList = &Search->GraphOpenList;
+
+    search_node *Root = TouchGraphNode(StartNode, Search);
+    Root->Parent = (point) {StartNode, 0};
+    Root->g = 0.0;
+    Root->h = abs(Start.Row - End.Row) + abs(Start.Col - End.Col);
+    Root->f = Root->h;
+    PushHeap(OpenList, (point) {StartNode, 0});
+
+    bool Found = false;
+    while (!IsHeapEmpty(OpenList)) {
+        int u = PopHeap(OpenList).Row;
+        Nodes[u].Closed = true;
+        Search->Expanded++;
+
+        if (u == EndNode) {
+            Found = true;
+            break;
+        }
+
+        int Length;
+        road_edge *Edges;
+        road_edge Extra[5];
+
+        if (u == StartNode) {
+            Length = StartAnchorsLength;
+            memcpy(Extra, StartAnchors, Length * sizeof(road_edge));
+            if (Direct >= 0)
+                Extra[Length++] = (road_edge) {EndNode, Direct};
+            Edges = Extra;
+        } else {
+            Length = Roads->Nodes[u].EdgesLength;
+            Edges = Roads->Nodes[u].Edges;
+        }
+
+        // the goal hangs off the nodes at the ends of its corridor
+        for (int k = 0; k < Length + EndAnchorsLength; k++) {
+            road_edge Edge;
+            if (k < Length)
+                Edge = Edges[k];
+            else if (u != StartNode && EndAnchors[k - Length].To == u)
+                Edge = (road_edge) {EndNode, EndAnchors[k - Length].Cost};
+            else
+                continue;
+
+            search_node *Next = TouchGraphNode(Edge.To, Search);
+            if (Next->Closed)
+                continue;
+
+            point Location = RoadLocation(Roads, Edge.To, Start, End);
+            double gNew = Nodes[u].g + Edge.Cost;
+            if (Next->f < 0 || gNew < Next->g) {
+                Next->g = gNew;
+                Next->h = abs(Location.Row - End.Row) + abs(Location.Col - End.Col);
+                Next->f = gNew + Next->h;
+                Next->Parent = (point) {u, 0};
+                DecreaseKeyHeap(OpenList, (point) {Edge.To, 0});
+            }
+        }
+    }
+
+    Tpath *Route = NULL;
+    if (Found) {
+        // a Start or End that is a node itself shows up twice in a row
+        int Length = 0;
+        point Last = {-1, -1};
+        for (int u = EndNode; ; u = Nodes[u].Parent.Row) {
+            point Location = RoadLocation(Roads, u, Start, End);
+            if (!EqualPoints(Location, Last))
+                Length++;
+            Last = Location;
+            if (u == StartNode)
+                break;
+        }
+
+        Route = NewPath(Length);
+        int i = Length;
+        Last = (point) {-1, -1};
+        for (int u = EndNode; ; u = Nodes[u].Parent.Row) {
+            point Location = RoadLocation(Roads, u, Start, End);
+            if (!EqualPoints(Location, Last))
+                Route->Points[--i] = (path_point) {Location.Row, Location.Col};
+            Last = Location;
+            if (u == StartNode)
+                break;
+        }
+    }
+
+    return Route;
+}
+
+static void PushRoadCell(Tpath **Path, int *Capacity, point Location)
+{
+    Tpath *Corners = *Path;
+    path_point Point = {Location.Row, Location.Col};
+
+    if (Corners->Length >= 2 && IsStraightRun(Corners->Points[Corners->Length - 2], Corners->Points[Corners->Length - 1], Point)) {
+        Corners->Points[Corners->Length - 1] = Point;
+        return;
+    }
+
+    if (Corners->Length >= *Capacity) {
+        *Capacity *= 2;
+        Corners = (Tpath*) realloc(Corners, sizeof(Tpath) + *Capacity * sizeof(path_point));
+        *Path = Corners;
+    }
+
+    Corners->Points[Corners->Length++] = Point;
+}
+
+/*
+    Length of the corridor walk from From through direction k to To,
+    or -1 when it runs into another node (or a wall) first.
+*/
+static int WalkRoadLeg(road_graph *Roads, astar_grid *Grid, point From, int k, point To, Tpath **Path, int *Capacity)
+{
+    const int Directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    point Previous = From;
+    point Current = {From.Row + Directions[k][0], From.Col + Directions[k][1]};
+    if (!IsWalkable(Current, Grid))
+        return -1;
+
+    int Length = 1;
+    for (;;) {
+        if (Path != NULL)
+            PushRoadCell(Path, Capacity, Current);
+        if (EqualPoints(Current, To))
+            return Length;
+        if (RoadNodeAt(Roads, Grid, Current) >= 0)
+            return -1;
+
+        point Next = NextCorridorCell(Current, Previous, Grid);
+        Previous = Current;
+        Current = Next;
+        Length++;
+    }
+}
+
+/*
+    Turns the waypoints of a road route into the corners of the cells
+    it drives over. Only needed once a taxi actually follows the route,
+    and costs one walk down each corridor on it.
+*/
+Tpath * ExpandRoadRoute(Tpath *Route, astar_grid *Grid)
+{
+    road_graph *Roads = Grid->Roads;
+    if (IsPathEmpty(Route) || Roads == NULL || Roads->Version != Grid->Version)
+        return NULL;
+
+    int Capacity = 16;
+    Tpath *Path = NewPath(Capacity);
+    Path->Length = 0;
+    PushRoadCell(&Path, &Capacity, PeekPath(Route));
+
+    for (int i = Route->Cursor + 1; i < Route->Length; i++) {
+        point From = GetPathPoint(Route, i - 1);
+        point To = GetPathPoint(Route, i);
+
+        // between two nodes the shortest corridor is the one the search took
+        int Best = -1, BestLength = INT_MAX;
+        for (int k = 0; k < 4; k++) {
+            int Length = WalkRoadLeg(Roads, Grid, From, k, To, NULL, NULL);
+            if (Length > 0 && Length < BestLength) {
+                Best = k;
+                BestLength = Length;
+            }
+        }
+
+        if (Best < 0) {
+            DestroyPath(&Path);
+            return NULL;
+        }
+
+        WalkRoadLeg(Roads, Grid, From, Best, To, &Path, &Capacity);
+    }
+
+    return (Tpath*) realloc(Path, sizeof(Tpath) + Path->Length * sizeof(path_point));
+}
+
+/*
+    Falls back to a cell search while the graph waits for RefreshAStarGrid
+    to catch up with the grid.
+*/
+Tpath * FindPathRoadGraph(point Start, point End, astar_grid *Grid, astar_search *Search)
+{
+    road_graph *Roads = Grid->Roads;
+    if (Roads == NULL || Roads->Version != Grid->Version)
+        return FindPathJPS(Start, End, Grid, Search);
+
+    Tpath *Route = FindRoadRoute(Start, End, Grid, Search);
+    Tpath *Path = ExpandRoadRoute(Route, Grid);
+    DestroyPath(&Route);
+
+    return Path;
+}
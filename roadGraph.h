@@ -0,0 +1,39 @@
+typedef struct road_edge {
+	int To;
+	int Cost;
+} road_edge;
+
+typedef struct road_node {
+	point Location;
+	road_edge *Edges;
+	int EdgesLength, EdgesCapacity;
+} road_node;
+
+/*
+	Compact road network: every open cell that is not a plain corridor
+	cell (exactly two open neighbours) is a node, and each corridor
+	between two nodes is one edge weighted by its length in cells.
+	Cells in the middle of a corridor (pickup spots included) are not
+	stored; a search plugs them in by walking to both ends.
+
+	The saving is only as large as the corridors are long: on the game's
+	map, whose blocks are open ground, nearly every open cell is a node.
+	There the graph is mainly what the contraction and the hub labels 
+	the dispatcher ranks taxis on are built from.
+*/
+typedef struct road_graph {
+	unsigned int Version;
+	int CellsLength;
+	int OpenCellsLength;
+
+	road_node *Nodes;
+	int NodesLength, NodesCapacity;
+	int *NodeAt;
+	int EdgesLength;
+} road_graph;
+
+road_graph *		CreateRoadGraph(astar_grid *Grid);
+void 				BuildRoadGraph(road_graph *Roads, astar_grid *Grid);
+void 				DestroyRoadGraph(road_graph *Roads);
+Tpath *				FindRoadRoute(point Start, point End, astar_grid *Grid, astar_search *Search);
+Tpath *				ExpandRoadRoute(Tpath *Route, astar_grid *Grid);
@@ -0,0 +1,176 @@
+#include "routeCache.h"
+
+static int HashRoute(route_cache *Cache, point Start, point End) 
+{
+    unsigned int Hash = (unsigned int) Start.Row * 73856093u ^ (unsigned int) Start.Col * 19349663u
+                      ^ (unsigned int) End.Row * 83492791u ^ (unsigned int) End.Col * 2654435761u;
+    return Hash & (Cache->BucketsLength - 1);
+}
+
+static void UnlinkEntry(route_cache *Cache, int i) 
+{
+    route_cache_entry *Entry = &Cache->Entries[i];
+    if (Entry->Previous >= 0)
+        Cache->Entries[Entry->Previous].Next = Entry->Next;
+    else
+        Cache->Head = Entry->Next;
+
+    if (Entry->Next >= 0)
+        Cache->Entries[Entry->Next].Previous = Entry->Previous;
+    else
+        Cache->Tail = Entry->Previous;
+}
+
+static void LinkEntryAtHead(route_cache *Cache, int i) 
+{
+    route_cache_entry *Entry = &Cache->Entries[i];
+    Entry->Previous = -1;
+    Entry->Next = Cache->Head;
+    if (Cache->Head >= 0)
+        Cache->Entries[Cache->Head].Previous = i;
+    Cache->Head = i;
+    if (Cache->Tail < 0)
+        Cache->Tail = i;
+}
+
+static int FindEntry(route_cache *Cache, point Start, point End) 
+{
+    int i = Cache->Buckets[HashRoute(Cache, Start, End)];
+    while (i >= 0) {
+        route_cache_entry *Entry = &Cache->Entries[i];
+        if (EqualPoints(Entry->Start, Start) && EqualPoints(Entry->End, End))
+            return i;
+        i = Entry->NextInBucket;
+    }
+
+    return -1;
+}
+
+static void RemoveFromBucket(route_cache *Cache, int i) 
+{
+    route_cache_entry *Entry = &Cache->Entries[i];
+    int *Link = &Cache->Buckets[HashRoute(Cache, Entry->Start, Entry->End)];
+    while (*Link != i) {
+        Link = &Cache->Entries[*Link].NextInBucket;
+    }
+    *Link = Entry->NextInBucket;
+}
+
+static void FlushStaleRoutes(route_cache *Cache, astar_grid *Grid) 
+{
+    if (Cache->Version != Grid->Version) {
+        FlushRouteCache(Cache);
+        Cache->Version = Grid->Version;
+    }
+}
+
+route_cache * CreateRouteCache(int Capacity) 
+{
+    route_cache *Cache = (route_cache*) malloc(sizeof(route_cache));
+    Cache->Entries = (route_cache_entry*) malloc(Capacity * sizeof(route_cache_entry));
+    Cache->Capacity = Capacity;
+    Cache->Length = 0;
+
+    Cache->BucketsLength = 1;
+    while (Cache->BucketsLength < 2 * Capacity) {
+        Cache->BucketsLength <<= 1;
+    }
+    Cache->Buckets = (int*) malloc(Cache->BucketsLength * sizeof(int));
+    for (int i = 0; i < Cache->BucketsLength; i++) {
+        Cache->Buckets[i] = -1;
+    }
+
+    Cache->Head = Cache->Tail = -1;
+    Cache->Version = 0;
+    Cache->Hits = Cache->Misses = 0;
+    pthread_mutex_init(&Cache->Lock, NULL);
+
+    return Cache;
+}
+
+/*
+    On a hit *Path receives a private copy of the cached route (NULL 
+    when the goal is known to be unreachable) and the entry becomes the
+    most recently used one.
+*/
+bool LookupRoute(route_cache *Cache, point Start, point End, astar_grid *Grid, Tpath **Path) 
+{
+    pthread_mutex_lock(&Cache->Lock);
+    FlushStaleRoutes(Cache, Grid);
+
+    int i = FindEntry(Cache, Start, End);
+    if (i < 0) {
+        Cache->Misses++;
+        pthread_mutex_unlock(&Cache->Lock);
+        return false;
+    }
+
+    UnlinkEntry(Cache, i);
+    LinkEntryAtHead(Cache, i);
+    *Path = CopyPath(Cache->Entries[i].Path);
+    Cache->Hits++;
+    pthread_mutex_unlock(&Cache->Lock);
+
+    return true;
+}
+
+/*
+    Keeps a copy of Path, evicting the least recently used route when
+    the cache is full.
+*/
+void StoreRoute(route_cache *Cache, point Start, point End, Tpath *Path, astar_grid *Grid) 
+{
+    pthread_mutex_lock(&Cache->Lock);
+    FlushStaleRoutes(Cache, Grid);
+
+    int i = FindEntry(Cache, Start, End);
+    if (i >= 0) {
+        UnlinkEntry(Cache, i);
+        RemoveFromBucket(Cache, i);
+        DestroyPath(&Cache->Entries[i].Path);
+    } else if (Cache->Length < Cache->Capacity) {
+        i = Cache->Length++;
+    } else {
+        i = Cache->Tail;
+        UnlinkEntry(Cache, i);
+        RemoveFromBucket(Cache, i);
+        DestroyPath(&Cache->Entries[i].Path);
+    }
+
+    route_cache_entry *Entry = &Cache->Entries[i];
+    Entry->Start = Start;
+    Entry->End = End;
+    Entry->Path = CopyPath(Path);
+
+    int Bucket = HashRoute(Cache, Start, End);
+    Entry->NextInBucket = Cache->Buckets[Bucket];
+    Cache->Buckets[Bucket] = i;
+    LinkEntryAtHead(Cache, i);
+
+    pthread_mutex_unlock(&Cache->Lock);
+}
+
+void FlushRouteCache(route_cache *Cache) 
+{
+    for (int i = 0; i < Cache->Length; i++) {
+        DestroyPath(&Cache->Entries[i].Path);
+    }
+    for (int i = 0; i < Cache->BucketsLength; i++) {
+        Cache->Buckets[i] = -1;
+    }
+
+    Cache->Length = 0;
+    Cache->Head = Cache->Tail = -1;
+}
+
+void DestroyRouteCache(route_cache *Cache) 
+{
+    if (Cache == NULL)
+        return;
+
+    FlushRouteCache(Cache);
+    pthread_mutex_destroy(&Cache->Lock);
+    free(Cache->Buckets);
+    free(Cache->Entries);
+    free(Cache);
+}
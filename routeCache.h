@@ -0,0 +1,30 @@
+typedef struct route_cache_entry {
+	point Start, End;
+	Tpath *Path;
+	int Previous, Next;
+	int NextInBucket;
+} route_cache_entry;
+
+/*
+	Bounded LRU cache of planned routes keyed by (Start, End). Entries
+	are kept in a doubly linked list from the most (Head) to the least
+	(Tail) recently used one and found through a chained hash table.
+	The whole cache is flushed once the grid moves to a new Version.
+*/
+typedef struct route_cache {
+	route_cache_entry *Entries;
+	int Length, Capacity;
+	int *Buckets;
+	int BucketsLength;
+	int Head, Tail;
+	unsigned int Version;
+
+	int Hits, Misses;
+	pthread_mutex_t Lock;
+} route_cache;
+
+route_cache *		CreateRouteCache(int Capacity);
+bool 				LookupRoute(route_cache *Cache, point Start, point End, astar_grid *Grid, Tpath **Path);
+void 				StoreRoute(route_cache *Cache, point Start, point End, Tpath *Path, astar_grid *Grid);
+void 				FlushRouteCache(route_cache *Cache);
+void 				DestroyRouteCache(route_cache *Cache);
@@ -0,0 +1,560 @@
+/*
+	Checks the search modes against plain breadth first distances on
+	random maps: `make test`. Builds only the search modules, so it
+	needs no SDL. Exits with 1 when any check fails.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <limits.h>
+#include <time.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "aStar.c"
+#include "hpa.c"
+#include "roadGraph.c"
+#include "contraction.c"
+#include "hubLabels.c"
+#include "routeCache.c"
+#include "dStarLite.c"
+#include "planner.c"
+
+#define TEST_ROWS 45
+#define TEST_COLS 80
+#define TEST_MAPS 6
+#define TEST_PAIRS 150
+#define TEST_WEIGHT 1.5
+#define TEST_SOURCES 12
+#define TEST_CANDIDATES 3
+#define TEST_JOBS 64
+#define TEST_WORKERS 4
+// how long the planner tests wait for their jobs before calling them lost
+#define TEST_WAIT_MS 5000
+
+static int Failures = 0;
+
+void Expect(bool Condition, const char *Format, ...)
+{
+	if (Condition)
+		return;
+
+	va_list Arguments;
+	va_start(Arguments, Format);
+	printf("FAIL: ");
+	vprintf(Format, Arguments);
+	printf("\n");
+	va_end(Arguments);
+	Failures++;
+}
+
+/* How a mode's route has to compare with the breadth first distance. */
+typedef enum route_check {
+	ROUTE_SHORTEST,
+	ROUTE_ANY,
+	ROUTE_BOUNDED
+} route_check;
+
+typedef struct tested_mode {
+	search_mode Mode;
+	const char *Name;
+	route_check Check;
+} tested_mode;
+
+static const tested_mode TestedModes[] = {
+	{SEARCH_MODE_ASTAR, "astar", ROUTE_SHORTEST},
+	{SEARCH_MODE_JPS, "jps", ROUTE_SHORTEST},
+	{SEARCH_MODE_BIDIRECTIONAL, "bidirectional", ROUTE_SHORTEST},
+	{SEARCH_MODE_HIERARCHICAL, "hierarchical", ROUTE_ANY},
+	{SEARCH_MODE_ROAD_GRAPH, "road graph", ROUTE_SHORTEST},
+	{SEARCH_MODE_CONTRACTION, "contraction", ROUTE_SHORTEST},
+	{SEARCH_MODE_WEIGHTED, "weighted", ROUTE_BOUNDED},
+	{SEARCH_MODE_ANYTIME, "anytime", ROUTE_SHORTEST},
+	{SEARCH_MODE_BUCKET, "bucket", ROUTE_SHORTEST},
+};
+
+static const heuristic_type TestedHeuristics[] = {HEURISTIC_MANHATTAN, HEURISTIC_LANDMARKS};
+
+bool IsOpenCellFunction(point Location, void *AStarGrid)
+{
+	return ((astar_grid*) AStarGrid)->Map[Location.Row][Location.Col].MovementCost == 1;
+}
+
+/*
+	Even maps are the game's city blocks with a few road cells closed,
+	odd maps are open ground with scattered walls, which gives the
+	road graph many junctions and short corridors.
+*/
+astar_grid * CreateTestGrid(int Map)
+{
+	astar_grid *Grid = (astar_grid*) malloc(sizeof(astar_grid));
+	Grid->NumberRows = TEST_ROWS;
+	Grid->NumberCols = TEST_COLS;
+	Grid->IsOpenCellFunction = IsOpenCellFunction;
+	Grid->Version = 0;
+	Grid->Map = (cell**) malloc(Grid->NumberRows * sizeof(cell*));
+	for (int i = 0; i < Grid->NumberRows; i++) {
+		Grid->Map[i] = (cell*) calloc(Grid->NumberCols, sizeof(cell));
+		for (int j = 0; j < Grid->NumberCols; j++) {
+			bool Road = i % 10 == 2 || j % 10 == 2;
+			if (Map % 2 == 0)
+				Grid->Map[i][j].MovementCost = Road ? rand() % 12 != 0 : 0;
+			else
+				Grid->Map[i][j].MovementCost = rand() % 4 != 0;
+			Grid->Map[i][j].Location = (point) {i, j};
+		}
+	}
+
+	Grid->Passability = CreatePassability(Grid);
+	Grid->Components = CreateComponents(Grid);
+	Grid->Landmarks = CreateLandmarks(Grid, 4);
+	Grid->Hierarchy = CreateHierarchy(Grid, 10);
+	Grid->Roads = CreateRoadGraph(Grid);
+	Grid->Contraction = CreateContraction(Grid);
+	Grid->HubLabels = CreateHubLabels(Grid);
+
+	return Grid;
+}
+
+void DestroyTestGrid(astar_grid *Grid)
+{
+	for (int i = 0; i < Grid->NumberRows; i++) {
+		free(Grid->Map[i]);
+	}
+
+	DestroyLandmarks(Grid->Landmarks);
+	DestroyHierarchy(Grid->Hierarchy);
+	DestroyRoadGraph(Grid->Roads);
+	DestroyContraction(Grid->Contraction);
+	DestroyHubLabels(Grid->HubLabels);
+	DestroyComponents(Grid->Components);
+	DestroyPassability(Grid->Passability);
+	free(Grid->Map);
+	free(Grid);
+}
+
+point RandomOpenCell(astar_grid *Grid)
+{
+	point Location;
+	do {
+		Location = (point) {rand() % Grid->NumberRows, rand() % Grid->NumberCols};
+	} while (!IsOpenCellFunction(Location, Grid));
+
+	return Location;
+}
+
+/* An open cell at most Reach rows and columns from Near, or Near itself. */
+point NearbyOpenCell(astar_grid *Grid, point Near, int Reach)
+{
+	for (int Attempt = 0; Attempt < 20; Attempt++) {
+		point Location = {Near.Row + rand() % (2 * Reach + 1) - Reach, Near.Col + rand() % (2 * Reach + 1) - Reach};
+		if (Location.Row >= 0 && Location.Row < Grid->NumberRows && Location.Col >= 0 && Location.Col < Grid->NumberCols
+			&& IsOpenCellFunction(Location, Grid))
+			return Location;
+	}
+
+	return Near;
+}
+
+/*
+	A route has to run from Start to End in straight runs over open cells.
+	Returns how many cells it drives over, or -1 when it is broken.
+*/
+int CheckedPathDistance(Tpath *Path, point Start, point End, astar_grid *Grid)
+{
+	if (Path == NULL || Path->Length == 0)
+		return -1;
+	if (!EqualPoints(GetPathPoint(Path, 0), Start) || !EqualPoints(GetPathPoint(Path, Path->Length - 1), End))
+		return -1;
+
+	for (int i = 1; i < Path->Length; i++) {
+		point From = GetPathPoint(Path, i - 1), To = GetPathPoint(Path, i);
+		if (From.Row != To.Row && From.Col != To.Col)
+			return -1;
+
+		for (point Cell = From; !EqualPoints(Cell, To); ) {
+			Cell.Row += (To.Row > Cell.Row) - (To.Row < Cell.Row);
+			Cell.Col += (To.Col > Cell.Col) - (To.Col < Cell.Col);
+			if (!IsOpenCellFunction(Cell, Grid))
+				return -1;
+		}
+	}
+
+	return PathDistance(Path);
+}
+
+/*
+	Every mode against the breadth first distance between the same pair.
+	Every other pair is close together, where Start and End often share
+	a corridor or sit at its ends.
+*/
+void TestSearchModes(astar_grid *Grid, astar_search *Search, int *Distances, int *Queue)
+{
+	int ModesLength = sizeof(TestedModes) / sizeof(TestedModes[0]);
+	int HeuristicsLength = sizeof(TestedHeuristics) / sizeof(TestedHeuristics[0]);
+
+	for (int t = 0; t < TEST_PAIRS; t++) {
+		point Start = RandomOpenCell(Grid);
+		point End = t % 2 == 0 ? RandomOpenCell(Grid) : NearbyOpenCell(Grid, Start, 3);
+		if (EqualPoints(Start, End))
+			continue;
+
+		BreadthFirstDistances(Grid, Start, Distances, Queue);
+		int Expected = Distances[End.Row * Grid->NumberCols + End.Col];
+
+		for (int h = 0; h < HeuristicsLength; h++) {
+			for (int m = 0; m < ModesLength; m++) {
+				const tested_mode *Tested = &TestedModes[m];
+				Search->Heuristic = TestedHeuristics[h];
+				Search->Mode = Tested->Mode;
+				Tpath *Path = FindPath(Start, End, Grid, Search);
+
+				if (Expected < 0) {
+					Expect(Path == NULL, "%s found a route (%d %d)->(%d %d) BFS cannot reach",
+						   Tested->Name, Start.Row, Start.Col, End.Row, End.Col);
+					DestroyPath(&Path);
+					continue;
+				}
+
+				int Distance = CheckedPathDistance(Path, Start, End, Grid);
+				bool Passed = Distance == Expected;
+				if (Tested->Check == ROUTE_ANY)
+					Passed = Distance >= Expected;
+				else if (Tested->Check == ROUTE_BOUNDED)
+					Passed = Distance >= Expected && Distance <= Search->Bound * Expected + 1e-9 && Search->Bound <= Search->Weight;
+				Expect(Passed, "%s route (%d %d)->(%d %d) is %d cells with bound %.3f, BFS %d",
+					   Tested->Name, Start.Row, Start.Col, End.Row, End.Col, Distance, Search->Bound, Expected);
+				DestroyPath(&Path);
+			}
+		}
+	}
+}
+
+/* The hub label distances against breadth first ones, reachable or not. */
+void TestRoadDistance(astar_grid *Grid, int *Distances, int *Queue)
+{
+	for (int t = 0; t < TEST_PAIRS; t++) {
+		point Start = RandomOpenCell(Grid);
+		point End = t % 2 == 0 ? RandomOpenCell(Grid) : NearbyOpenCell(Grid, Start, 3);
+
+		BreadthFirstDistances(Grid, Start, Distances, Queue);
+		int Expected = Distances[End.Row * Grid->NumberCols + End.Col];
+		int Distance = RoadDistance(Start, End, Grid);
+		Expect(Distance == Expected, "RoadDistance (%d %d)->(%d %d) is %d, BFS %d",
+			   Start.Row, Start.Col, End.Row, End.Col, Distance, Expected);
+	}
+}
+
+/*
+	The taxis the dispatcher ranks on the hub labels have to be as near
+	as the ones a search out of the order finds: the same distances, 
+	closest first.
+*/
+void TestNearestByRoad(astar_grid *Grid, astar_search *Search)
+{
+	point Sources[TEST_SOURCES];
+	int Nearest[TEST_CANDIDATES], Distances[TEST_CANDIDATES];
+	int SearchNearest[TEST_CANDIDATES], SearchDistances[TEST_CANDIDATES];
+
+	for (int t = 0; t < TEST_PAIRS; t++) {
+		point Goal = RandomOpenCell(Grid);
+		for (int i = 0; i < TEST_SOURCES; i++) {
+			Sources[i] = i % 2 == 0 ? RandomOpenCell(Grid) : NearbyOpenCell(Grid, Goal, 5);
+		}
+
+		int Found = FindNearestByRoad(Goal, Sources, TEST_SOURCES, TEST_CANDIDATES, Grid, Search, Nearest, Distances);
+		int Expected = FindNearestSources(Goal, Sources, TEST_SOURCES, TEST_CANDIDATES, Grid, Search, SearchNearest, SearchDistances);
+		Expect(Found == Expected, "FindNearestByRoad to (%d %d) found %d taxis, the search %d", Goal.Row, Goal.Col, Found, Expected);
+		for (int i = 0; i < Found && i < Expected; i++) {
+			Expect(Distances[i] == SearchDistances[i] && RoadDistance(Sources[Nearest[i]], Goal, Grid) == Distances[i],
+				   "FindNearestByRoad to (%d %d): candidate %d is %d cells away, the search's %d",
+				   Goal.Row, Goal.Col, i, Distances[i], SearchDistances[i]);
+		}
+	}
+}
+
+/*
+	D* Lite: plan, close a cell in the middle of the route, repair from
+	the same start, then open it again and repair once more. Each repair
+	has to match a breadth first search on the edited map.
+*/
+void TestDStarRepair(astar_grid *Grid, int *Distances, int *Queue)
+{
+	dstar_search *Search = CreateDStarSearch(Grid);
+	int Repairs = 0;
+
+	for (int t = 0; t < TEST_PAIRS && Repairs < 20; t++) {
+		point Start = RandomOpenCell(Grid), End = RandomOpenCell(Grid);
+		BreadthFirstDistances(Grid, Start, Distances, Queue);
+		if (Distances[End.Row * Grid->NumberCols + End.Col] < 4)
+			continue;
+
+		Tpath *Path = DStarFindPath(Search, Start, End, Grid);
+		Expect(CheckedPathDistance(Path, Start, End, Grid) == Distances[End.Row * Grid->NumberCols + End.Col],
+			   "D* Lite route (%d %d)->(%d %d) is not the shortest", Start.Row, Start.Col, End.Row, End.Col);
+
+		// a cell the route drives over, away from both ends
+		point Blocked = Start;
+		int Steps = Distances[End.Row * Grid->NumberCols + End.Col] / 2;
+		for (int i = 1; Path != NULL && i < Path->Length && Steps > 0; i++) {
+			point To = GetPathPoint(Path, i);
+			while (!EqualPoints(Blocked, To) && Steps > 0) {
+				Blocked.Row += (To.Row > Blocked.Row) - (To.Row < Blocked.Row);
+				Blocked.Col += (To.Col > Blocked.Col) - (To.Col < Blocked.Col);
+				Steps--;
+			}
+		}
+		DestroyPath(&Path);
+
+		for (int Open = 0; Open <= 1; Open++) {
+			SetCellMovementCost(Grid, Blocked, Open);
+			DStarUpdateCell(Search, Blocked, Grid);
+			Path = DStarReplan(Search, Start, Grid);
+
+			BreadthFirstDistances(Grid, Start, Distances, Queue);
+			int Expected = Distances[End.Row * Grid->NumberCols + End.Col];
+			int Distance = Path != NULL ? CheckedPathDistance(Path, Start, End, Grid) : -1;
+			Expect(Distance == Expected, "D* Lite repair (%d %d)->(%d %d) with (%d %d) %s is %d cells, BFS %d",
+				   Start.Row, Start.Col, End.Row, End.Col, Blocked.Row, Blocked.Col, Open ? "open" : "closed", Distance, Expected);
+			DestroyPath(&Path);
+		}
+		Repairs++;
+	}
+
+	Expect(Repairs > 0, "no D* Lite repair was tried");
+	DestroyDStarSearch(Search);
+}
+
+/* What the planner handed back for each job of a test, by request Id. */
+typedef struct planned_jobs {
+	astar_grid *Grid;
+	int Dispatched[TEST_JOBS];
+	int Distances[TEST_JOBS];
+} planned_jobs;
+
+void RecordPlannedJob(path_request *Request, void *Data)
+{
+	planned_jobs *Jobs = (planned_jobs*) Data;
+	Jobs->Dispatched[Request->Id]++;
+	Jobs->Distances[Request->Id] = Request->Path != NULL ? CheckedPathDistance(Request->Path, Request->Start, Request->End, Jobs->Grid) : -1;
+	DestroyPath(&Request->Path);
+	DestroyPath(&Request->Route);
+}
+
+/* Dispatches finished jobs until Expected of them came back or TEST_WAIT_MS ran out. */
+int WaitForPlannedJobs(path_planner *Planner, int Expected)
+{
+	int Dispatched = 0;
+	for (int Waited = 0; Dispatched < Expected && Waited < TEST_WAIT_MS; Waited++) {
+		RefillPathBudget(Planner);
+		Dispatched += DispatchFinishedPaths(Planner);
+		usleep(1000);
+	}
+
+	return Dispatched;
+}
+
+/*
+	Submits a batch of jobs to the workers and cancels every third one,
+	while it is queued, running or already finished. The cancelled ones
+	must never reach their callback and the others must come back once,
+	with the shortest route.
+*/
+void TestPlannerCancel(astar_grid *Grid, int *Distances, int *Queue)
+{
+	path_planner *Planner = CreatePathPlanner(Grid, TEST_WORKERS, 0);
+	SetPathPlannerMode(Planner, SEARCH_MODE_ASTAR);
+	planned_jobs Jobs = {Grid};
+	point Ends[TEST_JOBS];
+	int Tickets[TEST_JOBS], Expected[TEST_JOBS];
+
+	for (int i = 0; i < TEST_JOBS; i++) {
+		path_request Request = {0};
+		Request.Id = i;
+		Request.Start = RandomOpenCell(Grid);
+		Request.End = Ends[i] = RandomOpenCell(Grid);
+		BreadthFirstDistances(Grid, Request.Start, Distances, Queue);
+		Expected[i] = Distances[Request.End.Row * Grid->NumberCols + Request.End.Col];
+		Tickets[i] = SubmitPathRequest(Planner, &Request, RecordPlannedJob, &Jobs);
+	}
+
+	for (int i = 0; i < TEST_JOBS; i += 3) {
+		CancelPathRequest(Planner, Tickets[i]);
+	}
+
+	int Kept = TEST_JOBS - (TEST_JOBS + 2) / 3;
+	int Dispatched = WaitForPlannedJobs(Planner, Kept);
+	Expect(Dispatched == Kept, "%d of %d planner jobs came back", Dispatched, Kept);
+	// cancelling a job that was handed back already does nothing
+	CancelPathRequest(Planner, Tickets[1]);
+
+	for (int i = 0; i < TEST_JOBS; i++) {
+		if (i % 3 == 0) {
+			Expect(Jobs.Dispatched[i] == 0, "cancelled planner job %d came back", i);
+		} else {
+			Expect(Jobs.Dispatched[i] == 1 && Jobs.Distances[i] == Expected[i], "planner job %d to (%d %d) came back %d times, %d cells, BFS %d",
+				   i, Ends[i].Row, Ends[i].Col, Jobs.Dispatched[i], Jobs.Distances[i], Expected[i]);
+		}
+	}
+
+	DestroyPathPlanner(Planner);
+}
+
+/* A job that starts at its goal comes back with the one cell, in every mode. */
+void TestPlannerAtGoal(astar_grid *Grid)
+{
+	path_planner *Planner = CreatePathPlanner(Grid, 1, 0);
+	planned_jobs Jobs = {Grid};
+	int ModesLength = sizeof(TestedModes) / sizeof(TestedModes[0]);
+
+	for (int m = 0; m < ModesLength && m < TEST_JOBS; m++) {
+		SetPathPlannerMode(Planner, TestedModes[m].Mode);
+		path_request Request = {0};
+		Request.Id = m;
+		Request.Start = Request.End = RandomOpenCell(Grid);
+		SubmitPathRequest(Planner, &Request, RecordPlannedJob, &Jobs);
+		WaitForPlannedJobs(Planner, 1);
+		Expect(Jobs.Dispatched[m] == 1 && Jobs.Distances[m] == 0, "%s planner job at its goal (%d %d) came back %d times, %d cells",
+			   TestedModes[m].Name, Request.Start.Row, Request.Start.Col, Jobs.Dispatched[m], Jobs.Distances[m]);
+	}
+
+	DestroyPathPlanner(Planner);
+}
+
+/* A taxi's trip as the game plans it: the abstract route first, then one leg at a time. */
+typedef struct routed_job {
+	point Start, End;
+	int Expected;
+	astar_search *Resume;
+	Tpath *Route;
+	Tpath *Path;
+	Tpath *Leg;
+	bool Answered, Done;
+} routed_job;
+
+void RecordRoutedLeg(path_request *Request, void *Data)
+{
+	routed_job *Job = &((routed_job*) Data)[Request->Id];
+	Job->Leg = Request->Path;
+	Job->Route = Request->Route;
+	Job->Answered = true;
+}
+
+point RandomEntrance(astar_grid *Grid)
+{
+	hpa_graph *Hierarchy = Grid->Hierarchy;
+	return Hierarchy->NodesLength > 0 ? Hierarchy->Nodes[rand() % Hierarchy->NodesLength].Location : RandomOpenCell(Grid);
+}
+
+/*
+	Hierarchical trips through the planner with a budget, so the legs are
+	sliced, and with many of them starting or ending on an entrance. Each
+	answer has to carry a leg until the route is refined, and the legs
+	together have to drive from Start to End.
+*/
+void TestPlannerLegs(astar_grid *Grid, int *Distances, int *Queue)
+{
+	path_planner *Planner = CreatePathPlanner(Grid, TEST_WORKERS, 0);
+	SetPathPlannerMode(Planner, SEARCH_MODE_HIERARCHICAL);
+	SetPathPlannerBudget(Planner, 400);
+	routed_job Jobs[TEST_JOBS] = {0};
+
+	for (int i = 0; i < TEST_JOBS; i++) {
+		routed_job *Job = &Jobs[i];
+		Job->Start = i % 2 == 0 ? RandomEntrance(Grid) : RandomOpenCell(Grid);
+		Job->End = i % 3 == 0 ? RandomEntrance(Grid) : RandomOpenCell(Grid);
+		Job->Resume = CreateAStarSearch(Grid);
+		BreadthFirstDistances(Grid, Job->Start, Distances, Queue);
+		Job->Expected = Distances[Job->End.Row * Grid->NumberCols + Job->End.Col];
+		Job->Done = EqualPoints(Job->Start, Job->End);
+		if (Job->Done)
+			continue;
+
+		path_request Request = {i, Job->Start, Job->End};
+		Request.Resume = Job->Resume;
+		SubmitPathRequest(Planner, &Request, RecordRoutedLeg, Jobs);
+	}
+
+	int Done = 0;
+	for (int Waited = 0; Done < TEST_JOBS && Waited < TEST_WAIT_MS; Waited++) {
+		RefillPathBudget(Planner);
+		DispatchFinishedPaths(Planner);
+
+		Done = 0;
+		for (int i = 0; i < TEST_JOBS; i++) {
+			routed_job *Job = &Jobs[i];
+			if (Job->Answered) {
+				Job->Answered = false;
+				if (Job->Leg == NULL) {
+					Expect(Job->Expected < 0, "hierarchical trip %d (%d %d)->(%d %d) got no leg at waypoint %d of %d",
+						   i, Job->Start.Row, Job->Start.Col, Job->End.Row, Job->End.Col,
+						   Job->Route != NULL ? Job->Route->Cursor : -1, Job->Route != NULL ? Job->Route->Length : 0);
+					Job->Done = true;
+				} else {
+					AppendPath(&Job->Path, Job->Leg);
+					Job->Leg = NULL;
+					Job->Done = IsRouteRefined(Job->Route);
+				}
+
+				if (Job->Done) {
+					if (Job->Path != NULL) {
+						int Distance = CheckedPathDistance(Job->Path, Job->Start, Job->End, Grid);
+						Expect(Distance >= Job->Expected && Job->Expected >= 0, "hierarchical trip %d (%d %d)->(%d %d) is %d cells, BFS %d",
+							   i, Job->Start.Row, Job->Start.Col, Job->End.Row, Job->End.Col, Distance, Job->Expected);
+					}
+				} else {
+					path_request Request = {i, Job->Start, Job->End};
+					Request.Route = Job->Route;
+					Request.Resume = Job->Resume;
+					SubmitPathRequest(Planner, &Request, RecordRoutedLeg, Jobs);
+				}
+			}
+			Done += Job->Done;
+		}
+		usleep(1000);
+	}
+	Expect(Done == TEST_JOBS, "%d of %d hierarchical trips finished", Done, TEST_JOBS);
+
+	DestroyPathPlanner(Planner);
+	for (int i = 0; i < TEST_JOBS; i++) {
+		DestroyPath(&Jobs[i].Path);
+		DestroyPath(&Jobs[i].Route);
+		DestroyAStarSearch(Jobs[i].Resume);
+	}
+}
+
+int main(int argc, char *args[])
+{
+	srand(argc > 1 ? atoi(args[1]) : 1);
+
+	for (int Map = 0; Map < TEST_MAPS; Map++) {
+		astar_grid *Grid = CreateTestGrid(Map);
+		astar_search *Search = CreateAStarSearch(Grid);
+		Search->Weight = TEST_WEIGHT;
+		int CellsLength = Grid->NumberRows * Grid->NumberCols;
+		int *Distances = (int*) malloc(CellsLength * sizeof(int));
+		int *Queue = (int*) malloc(CellsLength * sizeof(int));
+
+		TestSearchModes(Grid, Search, Distances, Queue);
+		TestRoadDistance(Grid, Distances, Queue);
+		TestNearestByRoad(Grid, Search);
+		TestPlannerCancel(Grid, Distances, Queue);
+		TestPlannerLegs(Grid, Distances, Queue);
+		TestPlannerAtGoal(Grid);
+		// the edits leave the grid's tables behind, so the modes are checked first
+		TestDStarRepair(Grid, Distances, Queue);
+
+		free(Queue);
+		free(Distances);
+		DestroyAStarSearch(Search);
+		DestroyTestGrid(Grid);
+	}
+
+	printf("%d failed checks\n", Failures);
+	return Failures > 0;
+}